@@ -0,0 +1,259 @@
+/*
+ * Information element parser benchmark.
+ *
+ * Times parse_ies() and print_ies() (with stdout going to /dev/null)
+ * over a corpus of element blobs, each file holding the elements of one
+ * beacon or probe response as they appear in the frame. With -f the
+ * blobs are also mutated, mostly in the element length bytes, and fed
+ * to the parsers in buffers of their exact size, so that running this
+ * under valgrind or with -fsanitize=address catches overreads.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "iw.h"
+
+/* what iw.c would provide; nothing here talks to the kernel */
+int iw_debug = 0;
+
+int nl80211_init(struct nl80211_state *state)
+{
+	return -EOPNOTSUPP;
+}
+
+void nl80211_cleanup(struct nl80211_state *state)
+{
+}
+
+int handle_cmd(struct nl80211_state *state, enum id_input idby,
+	       int argc, char **argv)
+{
+	return -EOPNOTSUPP;
+}
+
+struct blob {
+	const char *name;
+	unsigned char *data;
+	int len;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int load_blob(struct blob *b, const char *name)
+{
+	FILE *f = fopen(name, "rb");
+	long len;
+
+	if (!f)
+		return -errno;
+
+	if (fseek(f, 0, SEEK_END) || (len = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET)) {
+		fclose(f);
+		return -EIO;
+	}
+
+	b->name = name;
+	b->len = len;
+	b->data = malloc(len ? len : 1);
+	if (!b->data || fread(b->data, 1, len, f) != (size_t)len) {
+		free(b->data);
+		fclose(f);
+		return -EIO;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static void report(const char *what, unsigned long long ns,
+		   unsigned long long bytes, unsigned long long n)
+{
+	double secs = ns / 1e9;
+
+	fprintf(stderr, "%-8s %10llu blobs %8.3f s %10.2f MB/s %10.0f ns/blob\n",
+		what, n, secs, bytes / secs / 1e6, (double)ns / n);
+}
+
+/* xorshift, so that a fuzz run can be repeated with the same seed */
+static unsigned int rnd_state;
+
+static unsigned int rnd(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+static void mutate(unsigned char *buf, int len)
+{
+	int pos = 0, n = 0, pick, i;
+
+	if (!len)
+		return;
+
+	switch (rnd() % 4) {
+	case 0:
+	case 1:
+		/* bend the length of one element */
+		pick = rnd() % 8;
+		while (pos + 2 <= len && n < pick) {
+			pos += 2 + buf[pos + 1];
+			n++;
+		}
+		if (pos + 2 > len)
+			pos = 0;
+		if (pos + 1 < len)
+			buf[pos + 1] = rnd();
+		break;
+	case 2:
+		/* scribble over a few bytes anywhere */
+		for (i = rnd() % 4; i >= 0; i--)
+			buf[rnd() % len] = rnd();
+		break;
+	case 3:
+		/* claim more data for the last element than there is */
+		while (pos + 1 < len && pos + 2 + buf[pos + 1] < len)
+			pos += 2 + buf[pos + 1];
+		if (pos + 1 < len)
+			buf[pos + 1] += 1 + rnd() % 16;
+		break;
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-n <iterations>] [-f <mutations>] [-s <seed>] [-p] <file>*\n"
+		"\t-n  passes over the corpus for the timing (default 10000)\n"
+		"\t-f  mutated copies of every blob to parse after the timing\n"
+		"\t-s  random seed for the mutations\n"
+		"\t-p  print the decoded corpus to stdout and exit\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iterations = 10000, mutations = 0, it;
+	unsigned long long start, bytes = 0;
+	struct ie_model m;
+	struct blob *blobs;
+	bool print = false;
+	int n_blobs, i, opt, err;
+
+	rnd_state = 1;
+
+	while ((opt = getopt(argc, argv, "n:f:s:p")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			mutations = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			rnd_state = strtoul(optarg, NULL, 0);
+			if (!rnd_state)
+				rnd_state = 1;
+			break;
+		case 'p':
+			print = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	n_blobs = argc - optind;
+	if (!n_blobs || !iterations) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	blobs = calloc(n_blobs, sizeof(*blobs));
+	if (!blobs)
+		return 1;
+
+	for (i = 0; i < n_blobs; i++) {
+		err = load_blob(&blobs[i], argv[optind + i]);
+		if (err) {
+			fprintf(stderr, "%s: %s\n", argv[optind + i],
+				strerror(-err));
+			return 1;
+		}
+		bytes += blobs[i].len;
+	}
+
+	if (print) {
+		for (i = 0; i < n_blobs; i++) {
+			printf("%s:\n", blobs[i].name);
+			print_ies(blobs[i].data, blobs[i].len, true, PRINT_SCAN);
+		}
+		return 0;
+	}
+
+	fprintf(stderr, "%d blobs, %llu bytes, %lu passes\n",
+		n_blobs, bytes, iterations);
+
+	start = now_ns();
+	for (it = 0; it < iterations; it++)
+		for (i = 0; i < n_blobs; i++)
+			parse_ies(&m, blobs[i].data, blobs[i].len);
+	report("parse", now_ns() - start, bytes * iterations,
+	       (unsigned long long)n_blobs * iterations);
+
+	if (!freopen("/dev/null", "w", stdout)) {
+		perror("/dev/null");
+		return 1;
+	}
+
+	start = now_ns();
+	for (it = 0; it < iterations; it++)
+		for (i = 0; i < n_blobs; i++)
+			print_ies(blobs[i].data, blobs[i].len, true,
+				  PRINT_SCAN);
+	fflush(stdout);
+	report("print", now_ns() - start, bytes * iterations,
+	       (unsigned long long)n_blobs * iterations);
+
+	for (i = 0; i < n_blobs && mutations; i++) {
+		for (it = 0; it < mutations; it++) {
+			int len = blobs[i].len;
+			unsigned char *buf;
+
+			/* sometimes cut the blob short, too */
+			if (len && rnd() % 4 == 0)
+				len = rnd() % len;
+			buf = malloc(len ? len : 1);
+			if (!buf)
+				return 1;
+			memcpy(buf, blobs[i].data, len);
+			mutate(buf, len);
+			parse_ies(&m, buf, len);
+			print_ies(buf, len, true, PRINT_SCAN);
+			print_ies(buf, len, true, PRINT_LINK);
+			free(buf);
+		}
+	}
+	if (mutations)
+		fprintf(stderr, "fuzz     %10llu blobs survived\n",
+			(unsigned long long)n_blobs * mutations);
+
+	for (i = 0; i < n_blobs; i++)
+		free(blobs[i].data);
+	free(blobs);
+	return 0;
+}
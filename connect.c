@@ -79,7 +79,9 @@ static int iw_connect(struct nl80211_state *state, struct nl_cb *cb,
 		NL80211_CMD_CONNECT,
 	};
 	struct print_event_args printargs = { };
+	struct wait_opts opts = { };
 	int conn_argc, err;
+	__u32 res;
 	bool wait = false;
 	int i;
 
@@ -87,9 +89,18 @@ static int iw_connect(struct nl80211_state *state, struct nl_cb *cb,
 	argc -= 2;
 	argv += 2;
 
-	/* check -w */
-	if (argc && strcmp(argv[0], "-w") == 0) {
-		wait = true;
+	/* check -w and --timeout, the latter implies the former */
+	while (argc) {
+		if (strcmp(argv[0], "-w") == 0) {
+			wait = true;
+		} else if (strcmp(argv[0], "--timeout") == 0) {
+			if (argc < 2 || parse_timeout(argv[1], &opts.timeout))
+				return 1;
+			wait = true;
+			argc--;
+			argv++;
+		} else
+			break;
 		argc--;
 		argv++;
 	}
@@ -137,13 +148,25 @@ static int iw_connect(struct nl80211_state *state, struct nl_cb *cb,
 	 * Alas, the kernel doesn't do that (yet).
 	 */
 
-	__do_listen_events(state, ARRAY_SIZE(cmds), cmds, &printargs);
+	res = __do_listen_events(state, ARRAY_SIZE(cmds), cmds, &printargs,
+				 &opts);
+	if ((int)res < 0)
+		return res;
+	if (!res) {
+		fprintf(stderr, "connect timed out after %u.%03u seconds\n",
+			opts.elapsed / 1000, opts.elapsed % 1000);
+		return -ETIMEDOUT;
+	}
+	if (opts.timeout)
+		fprintf(stderr, "connect finished after %u.%03u seconds\n",
+			opts.elapsed / 1000, opts.elapsed % 1000);
 	return 0;
 }
-TOPLEVEL(connect, "[-w] <SSID> [<freq in MHz>] [<bssid>] [key 0:abcde d:1:6162636465]",
+TOPLEVEL(connect, "[-w [--timeout <seconds>]] <SSID> [<freq in MHz>] [<bssid>] [key 0:abcde d:1:6162636465]",
 	0, 0, CIB_NETDEV, iw_connect,
 	"Join the network with the given SSID (and frequency, BSSID).\n"
-	"With -w, wait for the connect to finish or fail.");
+	"With -w, wait for the connect to finish or fail; --timeout limits\n"
+	"that wait to the given number of seconds.");
 HIDDEN(connect, establish, "", NL80211_CMD_CONNECT, 0, CIB_NETDEV, iw_conn);
 
 static int iw_auth(struct nl80211_state *state, struct nl_cb *cb,
@@ -1,14 +1,34 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stdbool.h>
+#include <ctype.h>
 #include <net/if.h>
 #include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/epoll.h>
 #include "iw.h"
 
+#ifndef CLOCK_TAI
+#define CLOCK_TAI 11
+#endif
+
 static int no_seq_check(struct nl_msg *msg, void *arg)
 {
 	return NL_OK;
 }
 
+static unsigned long long monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return 1000000000ULL * ts.tv_sec + ts.tv_nsec;
+}
+
 struct ieee80211_beacon_channel {
 	__u16 center_freq;
 	bool no_ir;
@@ -290,7 +310,8 @@ static int print_event(struct nl_msg *msg, void *arg)
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct nlattr *tb[NL80211_ATTR_MAX + 1], *nst;
 	struct print_event_args *args = arg;
-	char ifname[100];
+	struct print_event_args *tsargs = args->parent ? args->parent : args;
+	struct ifcache *ifcache = args->ifcache ? args->ifcache : &iw_ifcache;
 	char macbuf[6*3];
 	__u8 reg_type;
 	struct ieee80211_beacon_channel chan_before_beacon,  chan_after_beacon;
@@ -299,34 +320,40 @@ static int print_event(struct nl_msg *msg, void *arg)
 	__u16 status;
 
 	if (args->time || args->reltime) {
-		unsigned long long usecs, previous;
+		unsigned long long nsecs, previous;
 
-		previous = 1000000ULL * args->ts.tv_sec + args->ts.tv_usec;
-		gettimeofday(&args->ts, NULL);
-		usecs = 1000000ULL * args->ts.tv_sec + args->ts.tv_usec;
+		previous = 1000000000ULL * tsargs->ts.tv_sec +
+			   tsargs->ts.tv_nsec;
+		clock_gettime(args->clock, &tsargs->ts);
+		nsecs = 1000000000ULL * tsargs->ts.tv_sec + tsargs->ts.tv_nsec;
 		if (args->reltime) {
-			if (!args->have_ts) {
-				usecs = 0;
-				args->have_ts = true;
+			if (!tsargs->have_ts) {
+				nsecs = 0;
+				tsargs->have_ts = true;
 			} else
-				usecs -= previous;
+				nsecs -= previous;
 		}
-		printf("%llu.%06llu: ", usecs/1000000, usecs % 1000000);
+		printf("%llu.%09llu: ", nsecs/1000000000, nsecs % 1000000000);
 	}
 
+	if (args->netns)
+		printf("[%s] ", args->netns);
+
 	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
 		  genlmsg_attrlen(gnlh, 0), NULL);
 
 	if (tb[NL80211_ATTR_IFINDEX] && tb[NL80211_ATTR_WIPHY]) {
-		if_indextoname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]), ifname);
-		printf("%s (phy #%d): ", ifname, nla_get_u32(tb[NL80211_ATTR_WIPHY]));
+		printf("%s (phy #%d): ",
+		       ifcache_name(ifcache,
+				    nla_get_u32(tb[NL80211_ATTR_IFINDEX])),
+		       nla_get_u32(tb[NL80211_ATTR_WIPHY]));
 	} else if (tb[NL80211_ATTR_WDEV] && tb[NL80211_ATTR_WIPHY]) {
 		printf("wdev 0x%llx (phy #%d): ",
 			(unsigned long long)nla_get_u64(tb[NL80211_ATTR_WDEV]),
 			nla_get_u32(tb[NL80211_ATTR_WIPHY]));
 	} else if (tb[NL80211_ATTR_IFINDEX]) {
-		if_indextoname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]), ifname);
-		printf("%s: ", ifname);
+		printf("%s: ", ifcache_name(ifcache,
+					    nla_get_u32(tb[NL80211_ATTR_IFINDEX])));
 	} else if (tb[NL80211_ATTR_WDEV]) {
 		printf("wdev 0x%llx: ", (unsigned long long)nla_get_u64(tb[NL80211_ATTR_WDEV]));
 	} else if (tb[NL80211_ATTR_WIPHY]) {
@@ -359,6 +386,15 @@ static int print_event(struct nl_msg *msg, void *arg)
 		}
 		printf("\n");
 		break;
+	case NL80211_CMD_START_SCHED_SCAN:
+		printf("scheduled scan started\n");
+		break;
+	case NL80211_CMD_SCHED_SCAN_RESULTS:
+		printf("got scheduled scan results\n");
+		break;
+	case NL80211_CMD_SCHED_SCAN_STOPPED:
+		printf("scheduled scan stopped\n");
+		break;
 	case NL80211_CMD_REG_CHANGE:
 		printf("regulatory domain change: ");
 
@@ -571,6 +607,8 @@ static int print_event(struct nl_msg *msg, void *arg)
 		break;
 	}
 
+	ifcache_event(ifcache, gnlh->cmd, tb);
+
 	fflush(stdout);
 	return NL_SKIP;
 }
@@ -580,6 +618,7 @@ struct wait_event {
 	const __u32 *cmds;
 	__u32 cmd;
 	struct print_event_args *pargs;
+	struct wait_opts *opts;
 };
 
 static int wait_event(struct nl_msg *msg, void *arg)
@@ -590,6 +629,9 @@ static int wait_event(struct nl_msg *msg, void *arg)
 
 	for (i = 0; i < wait->n_cmds; i++) {
 		if (gnlh->cmd == wait->cmds[i]) {
+			if (wait->opts && wait->opts->match &&
+			    !wait->opts->match(msg, wait->opts->priv))
+				break;
 			wait->cmd = gnlh->cmd;
 			if (wait->pargs)
 				print_event(msg, wait->pargs);
@@ -648,10 +690,17 @@ int __prepare_listen_events(struct nl80211_state *state)
 
 __u32 __do_listen_events(struct nl80211_state *state,
 			 const int n_waits, const __u32 *waits,
-			 struct print_event_args *args)
+			 struct print_event_args *args,
+			 struct wait_opts *opts)
 {
 	struct nl_cb *cb = nl_cb_alloc(iw_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
 	struct wait_event wait_ev;
+	struct pollfd pfd = {
+		.fd = nl_socket_get_fd(state->nl_sock),
+		.events = POLLIN,
+	};
+	unsigned long long start, deadline = 0, now;
+	int ret;
 
 	if (!cb) {
 		fprintf(stderr, "failed to allocate netlink callbacks\n");
@@ -665,14 +714,35 @@ __u32 __do_listen_events(struct nl80211_state *state,
 		wait_ev.cmds = waits;
 		wait_ev.n_cmds = n_waits;
 		wait_ev.pargs = args;
+		wait_ev.opts = opts;
 		nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, wait_event, &wait_ev);
 	} else
 		nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, print_event, args);
 
 	wait_ev.cmd = 0;
 
-	while (!wait_ev.cmd)
+	start = monotonic_ns();
+	if (opts && opts->timeout)
+		deadline = start + opts->timeout * 1000000ULL;
+
+	while (!wait_ev.cmd) {
+		if (deadline) {
+			now = monotonic_ns();
+			if (now >= deadline)
+				break;
+			ret = poll(&pfd, 1, DIV_ROUND_UP(deadline - now, 1000000ULL));
+			if (ret < 0 && errno != EINTR) {
+				wait_ev.cmd = -errno;
+				break;
+			}
+			if (ret <= 0)
+				continue;
+		}
 		nl_recvmsgs(state->nl_sock, cb);
+	}
+
+	if (opts)
+		opts->elapsed = (monotonic_ns() - start) / 1000000;
 
 	nl_cb_put(cb);
 
@@ -680,7 +750,8 @@ __u32 __do_listen_events(struct nl80211_state *state,
 }
 
 __u32 listen_events(struct nl80211_state *state,
-		    const int n_waits, const __u32 *waits)
+		    const int n_waits, const __u32 *waits,
+		    struct wait_opts *opts)
 {
 	int ret;
 
@@ -688,7 +759,436 @@ __u32 listen_events(struct nl80211_state *state,
 	if (ret)
 		return ret;
 
-	return __do_listen_events(state, n_waits, waits, NULL);
+	return __do_listen_events(state, n_waits, waits, NULL, opts);
+}
+
+#define EVENT_STATS_MAX_DEVS	32
+/* inter-arrival histogram, bucket n counts gaps of [2^n, 2^(n+1)) usec */
+#define EVENT_STATS_HIST	32
+
+struct event_cmd_stats {
+	unsigned long long total, count;
+	unsigned long long last;
+	unsigned int hist[EVENT_STATS_HIST];
+};
+
+struct event_dev_stats {
+	int wiphy, ifindex;
+	struct event_cmd_stats *cmds[NL80211_CMD_MAX + 1];
+};
+
+struct event_stats {
+	unsigned long long start, interval_start;
+	unsigned int interval; /* ms */
+	unsigned long long rx_errors, dropped;
+	int n_devs;
+	struct event_dev_stats devs[EVENT_STATS_MAX_DEVS];
+};
+
+static struct event_cmd_stats *
+event_stats_entry(struct event_stats *stats, int wiphy, int ifindex, __u8 cmd)
+{
+	struct event_dev_stats *dev = NULL;
+	int i;
+
+	if (cmd > NL80211_CMD_MAX)
+		return NULL;
+
+	for (i = 0; i < stats->n_devs; i++) {
+		if (stats->devs[i].wiphy == wiphy &&
+		    stats->devs[i].ifindex == ifindex) {
+			dev = &stats->devs[i];
+			break;
+		}
+	}
+
+	if (!dev) {
+		if (stats->n_devs == EVENT_STATS_MAX_DEVS)
+			return NULL;
+		dev = &stats->devs[stats->n_devs++];
+		dev->wiphy = wiphy;
+		dev->ifindex = ifindex;
+	}
+
+	if (!dev->cmds[cmd])
+		dev->cmds[cmd] = calloc(1, sizeof(*dev->cmds[cmd]));
+
+	return dev->cmds[cmd];
+}
+
+static int count_event(struct nl_msg *msg, void *arg)
+{
+	struct event_stats *stats = arg;
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *attrs = genlmsg_attrdata(gnlh, 0);
+	int len = genlmsg_attrlen(gnlh, 0);
+	struct event_cmd_stats *entry;
+	struct nlattr *attr;
+	int wiphy = -1, ifindex = 0;
+	unsigned long long now, delta;
+
+	/* only look for the two attributes we need instead of a full parse */
+	attr = nla_find(attrs, len, NL80211_ATTR_WIPHY);
+	if (attr)
+		wiphy = nla_get_u32(attr);
+	attr = nla_find(attrs, len, NL80211_ATTR_IFINDEX);
+	if (attr)
+		ifindex = nla_get_u32(attr);
+
+	entry = event_stats_entry(stats, wiphy, ifindex, gnlh->cmd);
+	if (!entry) {
+		stats->dropped++;
+		return NL_SKIP;
+	}
+
+	now = monotonic_ns();
+	if (entry->total) {
+		int bucket = 0;
+
+		delta = (now - entry->last) / 1000;
+		if (delta)
+			bucket = 63 - __builtin_clzll(delta);
+		if (bucket >= EVENT_STATS_HIST)
+			bucket = EVENT_STATS_HIST - 1;
+		entry->hist[bucket]++;
+	}
+	entry->last = now;
+	entry->total++;
+	entry->count++;
+
+	return NL_SKIP;
+}
+
+static void print_usecs_short(unsigned long long usecs)
+{
+	if (usecs >= 1000000)
+		printf("%llus", usecs / 1000000);
+	else if (usecs >= 1000)
+		printf("%llums", usecs / 1000);
+	else
+		printf("%lluus", usecs);
+}
+
+static void print_event_stats(struct event_stats *stats,
+			      unsigned long long now)
+{
+	unsigned long long elapsed = (now - stats->interval_start) / 1000000;
+	int i, cmd, b;
+
+	printf("--- %llu.%03llu s (total %llu s)",
+	       elapsed / 1000, elapsed % 1000,
+	       (now - stats->start) / 1000000000);
+	if (stats->rx_errors)
+		printf(", %llu receive errors", stats->rx_errors);
+	if (stats->dropped)
+		printf(", %llu events not tracked", stats->dropped);
+	printf(" ---\n");
+	printf("%-12s %-5s %-26s %8s %9s %10s  %s\n", "dev", "phy", "event",
+	       "count", "rate/s", "total", "inter-arrival");
+
+	for (i = 0; i < stats->n_devs; i++) {
+		struct event_dev_stats *d = &stats->devs[i];
+		const char *dev = "-";
+
+		if (d->ifindex)
+			dev = iw_ifname(d->ifindex);
+
+		for (cmd = 0; cmd <= NL80211_CMD_MAX; cmd++) {
+			struct event_cmd_stats *e = d->cmds[cmd];
+			unsigned long long rate;
+
+			if (!e)
+				continue;
+
+			/* rate in 1/100 events per second */
+			rate = elapsed ? e->count * 100000 / elapsed : 0;
+			printf("%-12s ", dev);
+			if (d->wiphy >= 0)
+				printf("#%-4d ", d->wiphy);
+			else
+				printf("%-5s ", "-");
+			printf("%-26s %8llu %6llu.%.2llu %10llu ",
+			       command_name(cmd), e->count,
+			       rate / 100, rate % 100, e->total);
+			for (b = 0; b < EVENT_STATS_HIST; b++) {
+				if (!e->hist[b])
+					continue;
+				printf(" ");
+				print_usecs_short(1ULL << b);
+				printf(":%u", e->hist[b]);
+			}
+			printf("\n");
+
+			e->count = 0;
+			memset(e->hist, 0, sizeof(e->hist));
+		}
+	}
+
+	printf("\n");
+	fflush(stdout);
+	stats->rx_errors = 0;
+	stats->dropped = 0;
+}
+
+static int __do_event_stats(struct nl80211_state *state, unsigned int interval)
+{
+	struct nl_cb *cb = nl_cb_alloc(iw_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
+	struct event_stats *stats;
+	struct pollfd pfd = {
+		.fd = nl_socket_get_fd(state->nl_sock),
+		.events = POLLIN,
+	};
+	unsigned long long now, next;
+	int timeout, ret = 0;
+
+	stats = calloc(1, sizeof(*stats));
+	if (!cb || !stats) {
+		fprintf(stderr, "failed to allocate event statistics\n");
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, no_seq_check, NULL);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, count_event, stats);
+
+	stats->interval = interval;
+	stats->start = stats->interval_start = monotonic_ns();
+	next = stats->start + interval * 1000000ULL;
+
+	while (1) {
+		now = monotonic_ns();
+		if (now >= next) {
+			print_event_stats(stats, now);
+			stats->interval_start = now;
+			next += interval * 1000000ULL;
+			if (next <= now)
+				next = now + interval * 1000000ULL;
+			continue;
+		}
+
+		timeout = DIV_ROUND_UP(next - now, 1000000ULL);
+		ret = poll(&pfd, 1, timeout);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			break;
+		}
+		if (ret == 0)
+			continue;
+
+		/* e.g. an overrun means we lost events, but keep counting */
+		if (nl_recvmsgs(state->nl_sock, cb) < 0)
+			stats->rx_errors++;
+	}
+
+ out:
+	if (stats) {
+		int i, cmd;
+
+		for (i = 0; i < stats->n_devs; i++)
+			for (cmd = 0; cmd <= NL80211_CMD_MAX; cmd++)
+				free(stats->devs[i].cmds[cmd]);
+		free(stats);
+	}
+	if (cb)
+		nl_cb_put(cb);
+	return ret;
+}
+
+static int parse_event_clock(const char *name, clockid_t *clock)
+{
+	struct timespec ts;
+
+	if (strcmp(name, "realtime") == 0)
+		*clock = CLOCK_REALTIME;
+	else if (strcmp(name, "monotonic") == 0)
+		*clock = CLOCK_MONOTONIC;
+	else if (strcmp(name, "boottime") == 0)
+		*clock = CLOCK_BOOTTIME;
+	else if (strcmp(name, "tai") == 0)
+		*clock = CLOCK_TAI;
+	else
+		return 1;
+
+	/* older kernels don't know about all of these */
+	if (clock_gettime(*clock, &ts)) {
+		fprintf(stderr, "clock %s not supported: %s\n",
+			name, strerror(errno));
+		return 2;
+	}
+
+	return 0;
+}
+
+struct event_netns {
+	struct nl80211_state state;
+	struct ifcache ifcache;
+	struct print_event_args args;
+	struct nl_cb *cb;
+};
+
+/*
+ * Open an nl80211 socket in the network namespace given by a PID or a
+ * path (e.g. /var/run/netns/foo). A netlink socket stays bound to the
+ * namespace it was created in, so we only need to be in there for the
+ * socket creation and then go back.
+ */
+static int event_netns_open(struct event_netns *ns, const char *name)
+{
+	char path[64];
+	const char *p;
+	int self, fd, err;
+
+	for (p = name; isdigit(*p); p++)
+		;
+	if (!*p) {
+		snprintf(path, sizeof(path), "/proc/%s/ns/net", name);
+		name = path;
+	}
+
+	self = open("/proc/self/ns/net", O_RDONLY);
+	if (self < 0)
+		return -errno;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0) {
+		err = -errno;
+		fprintf(stderr, "cannot open namespace %s\n", name);
+		goto out_self;
+	}
+
+	if (setns(fd, CLONE_NEWNET)) {
+		err = -errno;
+		fprintf(stderr, "cannot enter namespace %s\n", name);
+		goto out;
+	}
+
+	err = nl80211_init(&ns->state);
+
+	if (setns(self, CLONE_NEWNET)) {
+		/* must not continue in the wrong namespace */
+		perror("setns");
+		exit(2);
+	}
+ out:
+	close(fd);
+ out_self:
+	close(self);
+	return err;
+}
+
+static int __do_listen_netns(struct nl80211_state *state,
+			     struct print_event_args *args,
+			     char *names)
+{
+	struct event_netns *nss;
+	struct epoll_event ev, evs[8];
+	int n_ns = 1, i, n, epfd, err = 0;
+	char *name, *saveptr = NULL;
+
+	for (name = names; *name; name++)
+		if (*name == ',')
+			n_ns++;
+	/* the first one is our own namespace */
+	n_ns++;
+
+	nss = calloc(n_ns, sizeof(*nss));
+	if (!nss)
+		return -ENOMEM;
+
+	nss[0].state = *state;
+	/*
+	 * Each namespace has its own tag and interface cache, the relative
+	 * timestamps are between events of all of them, so kept in *args.
+	 */
+	nss[0].args = *args;
+	nss[0].args.netns = "self";
+	nss[0].args.parent = args;
+
+	n_ns = 1;
+	for (name = strtok_r(names, ",", &saveptr); name;
+	     name = strtok_r(NULL, ",", &saveptr)) {
+		struct event_netns *ns = &nss[n_ns];
+
+		err = event_netns_open(ns, name);
+		if (err)
+			goto out;
+		n_ns++;
+
+		ns->ifcache.no_lookup = true;
+		err = ifcache_fill(&ns->ifcache, &ns->state);
+		if (err)
+			goto out;
+		err = __prepare_listen_events(&ns->state);
+		if (err)
+			goto out;
+
+		ns->args = *args;
+		ns->args.netns = name;
+		ns->args.ifcache = &ns->ifcache;
+		ns->args.parent = args;
+	}
+
+	epfd = epoll_create(n_ns);
+	if (epfd < 0) {
+		err = -errno;
+		goto out;
+	}
+
+	for (i = 0; i < n_ns; i++) {
+		struct event_netns *ns = &nss[i];
+
+		ns->cb = nl_cb_alloc(iw_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
+		if (!ns->cb) {
+			err = -ENOMEM;
+			goto out_close;
+		}
+		/* no sequence checking for multicast messages */
+		nl_cb_set(ns->cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM,
+			  no_seq_check, NULL);
+		nl_cb_set(ns->cb, NL_CB_VALID, NL_CB_CUSTOM,
+			  print_event, &ns->args);
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = ns;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD,
+			      nl_socket_get_fd(ns->state.nl_sock), &ev)) {
+			err = -errno;
+			goto out_close;
+		}
+	}
+
+	while (1) {
+		n = epoll_wait(epfd, evs, ARRAY_SIZE(evs), -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct event_netns *ns = evs[i].data.ptr;
+
+			nl_recvmsgs(ns->state.nl_sock, ns->cb);
+		}
+	}
+
+ out_close:
+	close(epfd);
+ out:
+	for (i = 0; i < n_ns; i++) {
+		if (nss[i].cb)
+			nl_cb_put(nss[i].cb);
+		if (i) {
+			nl80211_cleanup(&nss[i].state);
+			ifcache_free(&nss[i].ifcache);
+		}
+	}
+	free(nss);
+	return err;
 }
 
 static int print_events(struct nl80211_state *state,
@@ -698,9 +1198,14 @@ static int print_events(struct nl80211_state *state,
 			enum id_input id)
 {
 	struct print_event_args args;
+	bool have_clock = false;
+	unsigned int stats_interval = 0;
+	char *netns = NULL;
+	char *end;
 	int ret;
 
 	memset(&args, 0, sizeof(args));
+	args.clock = CLOCK_REALTIME;
 
 	argc--;
 	argv++;
@@ -712,7 +1217,27 @@ static int print_events(struct nl80211_state *state,
 			args.time = true;
 		else if (strcmp(argv[0], "-r") == 0)
 			args.reltime = true;
-		else
+		else if (strcmp(argv[0], "--clock") == 0 && argc > 1) {
+			ret = parse_event_clock(argv[1], &args.clock);
+			if (ret)
+				return ret;
+			have_clock = true;
+			argc--;
+			argv++;
+		} else if (strcmp(argv[0], "--netns") == 0 && argc > 1) {
+			netns = argv[1];
+			argc--;
+			argv++;
+		} else if (strcmp(argv[0], "--stats") == 0) {
+			stats_interval = 10000;
+			if (argc > 1 && isdigit(argv[1][0])) {
+				stats_interval = strtoul(argv[1], &end, 10) * 1000;
+				if (*end || !stats_interval)
+					return 1;
+				argc--;
+				argv++;
+			}
+		} else
 			return 1;
 		argc--;
 		argv++;
@@ -721,17 +1246,47 @@ static int print_events(struct nl80211_state *state,
 	if (args.time && args.reltime)
 		return 1;
 
+	if (netns && (stats_interval || !*netns))
+		return 1;
+
+	/* asking for a clock implies absolute timestamps */
+	if (have_clock && !args.reltime)
+		args.time = true;
+
 	if (argc)
 		return 1;
 
+	/*
+	 * Learn all interface names up front, the cache is then kept up
+	 * to date by the interface events. This has to happen before we
+	 * subscribe to the multicast groups.
+	 */
+	ret = ifcache_fill(&iw_ifcache, state);
+	if (ret)
+		return ret;
+
 	ret = __prepare_listen_events(state);
 	if (ret)
 		return ret;
 
-	return __do_listen_events(state, 0, NULL, &args);
+	if (stats_interval)
+		return __do_event_stats(state, stats_interval);
+
+	if (netns)
+		return __do_listen_netns(state, &args, netns);
+
+	return __do_listen_events(state, 0, NULL, &args, NULL);
 }
-TOPLEVEL(event, "[-t] [-r] [-f]", 0, 0, CIB_NONE, print_events,
+TOPLEVEL(event, "[-t] [-r] [-f] [--clock <realtime|monotonic|boottime|tai>] [--stats [<interval>]] [--netns <pid|path>[,...]]", 0, 0, CIB_NONE, print_events,
 	"Monitor events from the kernel.\n"
 	"-t - print timestamp\n"
 	"-r - print relative timstamp\n"
-	"-f - print full frame for auth/assoc etc.");
+	"-f - print full frame for auth/assoc etc.\n"
+	"--clock - clock used for timestamps (default realtime), implies -t\n"
+	"          unless -r is given; timestamps have nanosecond resolution\n"
+	"--stats - don't print events, instead print per device and event\n"
+	"          counts, rates and inter-arrival histograms every <interval>\n"
+	"          seconds (default 10)\n"
+	"--netns - also monitor the network namespaces of the given PIDs or\n"
+	"          namespace files, tagging each event with its namespace\n"
+	"          (\"self\" for our own)");
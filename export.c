@@ -0,0 +1,915 @@
+#include <net/if.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl80211.h"
+#include "iw.h"
+
+/*
+ * "iw export": a small HTTP server that serves the interface, station
+ * and survey dumps of all wireless interfaces as OpenMetrics text, for
+ * a Prometheus scraper. It keeps the one nl80211 socket, and does the
+ * dumps at most once per cache period: all the scrapes in between,
+ * and all those that come in at the same time, get the same document.
+ */
+
+#define EXPORT_MAX_CLIENTS	16
+#define EXPORT_REQ_MAX		4096
+#define EXPORT_CLIENT_TIMEOUT	10000	/* ms */
+
+struct export_array {
+	void *data;
+	int n, size;
+};
+
+#define export_at(a, type, i)	(&((type *)(a)->data)[i])
+
+struct export_iface {
+	__u32 ifindex, wiphy, iftype;
+	__u32 freq;			/* MHz, 0 if not known */
+	char name[IF_NAMESIZE];
+};
+
+enum export_sta_val {
+	EXPORT_STA_RX_BYTES,
+	EXPORT_STA_TX_BYTES,
+	EXPORT_STA_RX_PACKETS,
+	EXPORT_STA_TX_PACKETS,
+	EXPORT_STA_TX_RETRIES,
+	EXPORT_STA_TX_FAILED,
+	EXPORT_STA_SIGNAL,
+	EXPORT_STA_INACTIVE,
+	EXPORT_STA_CONNECTED,
+	EXPORT_STA_TX_BITRATE,
+	EXPORT_STA_RX_BITRATE,
+	EXPORT_STA_THROUGHPUT,
+	__EXPORT_STA_NUM,
+};
+
+struct export_sta {
+	__u32 ifindex;
+	unsigned char mac[ETH_ALEN];
+	__u32 present;			/* BIT(EXPORT_STA_*) */
+	long long val[__EXPORT_STA_NUM];
+};
+
+enum export_survey_val {
+	EXPORT_SURVEY_NOISE,
+	EXPORT_SURVEY_ACTIVE,
+	EXPORT_SURVEY_BUSY,
+	EXPORT_SURVEY_EXT_BUSY,
+	EXPORT_SURVEY_RX,
+	EXPORT_SURVEY_TX,
+	__EXPORT_SURVEY_NUM,
+};
+
+struct export_survey {
+	__u32 ifindex, freq;
+	bool in_use;
+	__u32 present;			/* BIT(EXPORT_SURVEY_*) */
+	long long val[__EXPORT_SURVEY_NUM];
+};
+
+struct export_metric {
+	const char *name;
+	const char *type;		/* "counter" or "gauge" */
+	int scale;			/* raw values per unit, ms -> s */
+	const char *help;
+};
+
+static const struct export_metric export_sta_metrics[] = {
+	[EXPORT_STA_RX_BYTES] = { "iw_station_rx_bytes", "counter", 1,
+		"Bytes received from the station." },
+	[EXPORT_STA_TX_BYTES] = { "iw_station_tx_bytes", "counter", 1,
+		"Bytes sent to the station." },
+	[EXPORT_STA_RX_PACKETS] = { "iw_station_rx_packets", "counter", 1,
+		"Packets received from the station." },
+	[EXPORT_STA_TX_PACKETS] = { "iw_station_tx_packets", "counter", 1,
+		"Packets sent to the station." },
+	[EXPORT_STA_TX_RETRIES] = { "iw_station_tx_retries", "counter", 1,
+		"Retransmissions to the station." },
+	[EXPORT_STA_TX_FAILED] = { "iw_station_tx_failed", "counter", 1,
+		"Packets that couldn't be sent to the station." },
+	[EXPORT_STA_SIGNAL] = { "iw_station_signal_dbm", "gauge", 1,
+		"Signal of the last frame from the station." },
+	[EXPORT_STA_INACTIVE] = { "iw_station_inactive_seconds", "gauge", 1000,
+		"Time since the last activity of the station." },
+	[EXPORT_STA_CONNECTED] = { "iw_station_connected_seconds", "gauge", 1,
+		"Time since the station connected." },
+	[EXPORT_STA_TX_BITRATE] = { "iw_station_tx_bitrate_bps", "gauge", 1,
+		"Bitrate of the last frame sent to the station." },
+	[EXPORT_STA_RX_BITRATE] = { "iw_station_rx_bitrate_bps", "gauge", 1,
+		"Bitrate of the last frame received from the station." },
+	[EXPORT_STA_THROUGHPUT] = { "iw_station_expected_throughput_bps",
+		"gauge", 1, "Throughput the driver expects for the station." },
+};
+
+static const struct export_metric export_survey_metrics[] = {
+	[EXPORT_SURVEY_NOISE] = { "iw_survey_noise_dbm", "gauge", 1,
+		"Noise level of the channel." },
+	[EXPORT_SURVEY_ACTIVE] = { "iw_survey_active_seconds", "counter", 1000,
+		"Time the radio was on the channel." },
+	[EXPORT_SURVEY_BUSY] = { "iw_survey_busy_seconds", "counter", 1000,
+		"Time the primary channel was sensed busy." },
+	[EXPORT_SURVEY_EXT_BUSY] = { "iw_survey_ext_busy_seconds", "counter",
+		1000, "Time the extension channel was sensed busy." },
+	[EXPORT_SURVEY_RX] = { "iw_survey_rx_seconds", "counter", 1000,
+		"Time the radio spent receiving on the channel." },
+	[EXPORT_SURVEY_TX] = { "iw_survey_tx_seconds", "counter", 1000,
+		"Time the radio spent sending on the channel." },
+};
+
+struct export_client {
+	int fd;
+	unsigned long long since;
+	char req[EXPORT_REQ_MAX];
+	size_t req_len;
+	char *resp;
+	size_t resp_len, resp_off;
+};
+
+static struct {
+	struct nl80211_state *state;
+	struct export_array ifaces, stas, surveys;
+	char *doc;
+	size_t doc_len, doc_size;
+	bool valid;
+	unsigned long long collected;	/* ms */
+	unsigned int cache;		/* ms */
+	unsigned long long collections, errors, duration_us;
+	struct export_client clients[EXPORT_MAX_CLIENTS];
+	int n_clients;
+} export;
+
+static unsigned long long export_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void *export_add(struct export_array *a, size_t elem)
+{
+	void *tmp;
+	int size;
+
+	if (a->n == a->size) {
+		size = a->size ? 2 * a->size : 16;
+		tmp = realloc(a->data, size * elem);
+		if (!tmp)
+			return NULL;
+		a->data = tmp;
+		a->size = size;
+	}
+	return memset((char *)a->data + a->n++ * elem, 0, elem);
+}
+
+static int error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
+			 void *arg)
+{
+	int *ret = arg;
+	*ret = err->error;
+	return NL_STOP;
+}
+
+static int finish_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+	*ret = 0;
+	return NL_SKIP;
+}
+
+static int export_dump(__u8 cmd, __u32 ifindex,
+		       int (*handler)(struct nl_msg *msg, void *arg))
+{
+	struct nl80211_state *state = export.state;
+	struct nl_msg *msg;
+	struct nl_cb *cb;
+	int err;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		return -ENOMEM;
+
+	cb = nl_cb_alloc(iw_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
+	if (!cb) {
+		err = -ENOMEM;
+		goto out_free_msg;
+	}
+
+	genlmsg_put(msg, 0, 0, state->nl80211_id, 0, NLM_F_DUMP, cmd, 0);
+	if (ifindex)
+		NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, ifindex);
+
+	err = nl_send_auto_complete(state->nl_sock, msg);
+	if (err < 0)
+		goto out;
+
+	err = 1;
+
+	nl_cb_err(cb, NL_CB_CUSTOM, error_handler, &err);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler, &err);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, handler, NULL);
+
+	while (err > 0)
+		if (nl_recvmsgs(state->nl_sock, cb) < 0 && err > 0)
+			err = -EIO;
+ out:
+	nl_cb_put(cb);
+ out_free_msg:
+	nlmsg_free(msg);
+	return err;
+ nla_put_failure:
+	err = -ENOBUFS;
+	goto out;
+}
+
+static int export_iface_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct export_iface *iface;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_IFINDEX] || !tb[NL80211_ATTR_IFNAME])
+		return NL_SKIP;
+
+	iface = export_add(&export.ifaces, sizeof(*iface));
+	if (!iface)
+		return NL_SKIP;
+
+	iface->ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+	snprintf(iface->name, sizeof(iface->name), "%s",
+		 nla_get_string(tb[NL80211_ATTR_IFNAME]));
+	if (tb[NL80211_ATTR_WIPHY])
+		iface->wiphy = nla_get_u32(tb[NL80211_ATTR_WIPHY]);
+	if (tb[NL80211_ATTR_IFTYPE])
+		iface->iftype = nla_get_u32(tb[NL80211_ATTR_IFTYPE]);
+	if (tb[NL80211_ATTR_WIPHY_FREQ])
+		iface->freq = nla_get_u32(tb[NL80211_ATTR_WIPHY_FREQ]);
+
+	return NL_SKIP;
+}
+
+static void export_sta_set(struct export_sta *sta, enum export_sta_val v,
+			   long long val)
+{
+	sta->val[v] = val;
+	sta->present |= BIT(v);
+}
+
+static int export_sta_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *sinfo[NL80211_STA_INFO_MAX + 1];
+	static struct nla_policy stats_policy[NL80211_STA_INFO_MAX + 1] = {
+		[NL80211_STA_INFO_INACTIVE_TIME] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_CONNECTED_TIME] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_RX_BYTES] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_TX_BYTES] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_RX_BYTES64] = { .type = NLA_U64 },
+		[NL80211_STA_INFO_TX_BYTES64] = { .type = NLA_U64 },
+		[NL80211_STA_INFO_RX_PACKETS] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_TX_PACKETS] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_TX_RETRIES] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_TX_FAILED] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_SIGNAL] = { .type = NLA_U8 },
+		[NL80211_STA_INFO_TX_BITRATE] = { .type = NLA_NESTED },
+		[NL80211_STA_INFO_RX_BITRATE] = { .type = NLA_NESTED },
+		[NL80211_STA_INFO_EXPECTED_THROUGHPUT] = { .type = NLA_U32 },
+	};
+	static const struct {
+		enum nl80211_sta_info attr;
+		enum export_sta_val val;
+	} u32_vals[] = {
+		{ NL80211_STA_INFO_RX_PACKETS, EXPORT_STA_RX_PACKETS },
+		{ NL80211_STA_INFO_TX_PACKETS, EXPORT_STA_TX_PACKETS },
+		{ NL80211_STA_INFO_TX_RETRIES, EXPORT_STA_TX_RETRIES },
+		{ NL80211_STA_INFO_TX_FAILED, EXPORT_STA_TX_FAILED },
+		{ NL80211_STA_INFO_INACTIVE_TIME, EXPORT_STA_INACTIVE },
+		{ NL80211_STA_INFO_CONNECTED_TIME, EXPORT_STA_CONNECTED },
+	};
+	struct export_sta *sta;
+	struct rate_info ri;
+	__u64 bytes;
+	int i;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_IFINDEX] || !tb[NL80211_ATTR_MAC] ||
+	    !tb[NL80211_ATTR_STA_INFO] ||
+	    nla_parse_nested(sinfo, NL80211_STA_INFO_MAX,
+			     tb[NL80211_ATTR_STA_INFO], stats_policy))
+		return NL_SKIP;
+
+	sta = export_add(&export.stas, sizeof(*sta));
+	if (!sta)
+		return NL_SKIP;
+
+	sta->ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+	memcpy(sta->mac, nla_data(tb[NL80211_ATTR_MAC]), ETH_ALEN);
+
+	if (sta_bytes(sinfo, false, &bytes))
+		export_sta_set(sta, EXPORT_STA_RX_BYTES, bytes);
+	if (sta_bytes(sinfo, true, &bytes))
+		export_sta_set(sta, EXPORT_STA_TX_BYTES, bytes);
+	for (i = 0; i < ARRAY_SIZE(u32_vals); i++)
+		if (sinfo[u32_vals[i].attr])
+			export_sta_set(sta, u32_vals[i].val,
+				       nla_get_u32(sinfo[u32_vals[i].attr]));
+	if (sinfo[NL80211_STA_INFO_SIGNAL])
+		export_sta_set(sta, EXPORT_STA_SIGNAL,
+			       (int8_t)nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL]));
+	if (sinfo[NL80211_STA_INFO_TX_BITRATE] &&
+	    !parse_rate_info(sinfo[NL80211_STA_INFO_TX_BITRATE], &ri) &&
+	    ri.bitrate)
+		export_sta_set(sta, EXPORT_STA_TX_BITRATE,
+			       ri.bitrate * 100000LL);
+	if (sinfo[NL80211_STA_INFO_RX_BITRATE] &&
+	    !parse_rate_info(sinfo[NL80211_STA_INFO_RX_BITRATE], &ri) &&
+	    ri.bitrate)
+		export_sta_set(sta, EXPORT_STA_RX_BITRATE,
+			       ri.bitrate * 100000LL);
+	if (sinfo[NL80211_STA_INFO_EXPECTED_THROUGHPUT])
+		export_sta_set(sta, EXPORT_STA_THROUGHPUT,
+			       nla_get_u32(sinfo[NL80211_STA_INFO_EXPECTED_THROUGHPUT]) *
+			       1000LL);
+
+	return NL_SKIP;
+}
+
+static int export_survey_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *sinfo[NL80211_SURVEY_INFO_MAX + 1];
+	static struct nla_policy survey_policy[NL80211_SURVEY_INFO_MAX + 1] = {
+		[NL80211_SURVEY_INFO_FREQUENCY] = { .type = NLA_U32 },
+		[NL80211_SURVEY_INFO_NOISE] = { .type = NLA_U8 },
+		[NL80211_SURVEY_INFO_CHANNEL_TIME] = { .type = NLA_U64 },
+		[NL80211_SURVEY_INFO_CHANNEL_TIME_BUSY] = { .type = NLA_U64 },
+		[NL80211_SURVEY_INFO_CHANNEL_TIME_EXT_BUSY] = { .type = NLA_U64 },
+		[NL80211_SURVEY_INFO_CHANNEL_TIME_RX] = { .type = NLA_U64 },
+		[NL80211_SURVEY_INFO_CHANNEL_TIME_TX] = { .type = NLA_U64 },
+	};
+	static const struct {
+		enum nl80211_survey_info attr;
+		enum export_survey_val val;
+	} u64_vals[] = {
+		{ NL80211_SURVEY_INFO_CHANNEL_TIME, EXPORT_SURVEY_ACTIVE },
+		{ NL80211_SURVEY_INFO_CHANNEL_TIME_BUSY, EXPORT_SURVEY_BUSY },
+		{ NL80211_SURVEY_INFO_CHANNEL_TIME_EXT_BUSY,
+		  EXPORT_SURVEY_EXT_BUSY },
+		{ NL80211_SURVEY_INFO_CHANNEL_TIME_RX, EXPORT_SURVEY_RX },
+		{ NL80211_SURVEY_INFO_CHANNEL_TIME_TX, EXPORT_SURVEY_TX },
+	};
+	struct export_survey *survey;
+	int i;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_IFINDEX] || !tb[NL80211_ATTR_SURVEY_INFO] ||
+	    nla_parse_nested(sinfo, NL80211_SURVEY_INFO_MAX,
+			     tb[NL80211_ATTR_SURVEY_INFO], survey_policy) ||
+	    !sinfo[NL80211_SURVEY_INFO_FREQUENCY])
+		return NL_SKIP;
+
+	survey = export_add(&export.surveys, sizeof(*survey));
+	if (!survey)
+		return NL_SKIP;
+
+	survey->ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+	survey->freq = nla_get_u32(sinfo[NL80211_SURVEY_INFO_FREQUENCY]);
+	survey->in_use = sinfo[NL80211_SURVEY_INFO_IN_USE];
+	if (sinfo[NL80211_SURVEY_INFO_NOISE]) {
+		survey->val[EXPORT_SURVEY_NOISE] =
+			(int8_t)nla_get_u8(sinfo[NL80211_SURVEY_INFO_NOISE]);
+		survey->present |= BIT(EXPORT_SURVEY_NOISE);
+	}
+	for (i = 0; i < ARRAY_SIZE(u64_vals); i++) {
+		if (!sinfo[u64_vals[i].attr])
+			continue;
+		survey->val[u64_vals[i].val] =
+			nla_get_u64(sinfo[u64_vals[i].attr]);
+		survey->present |= BIT(u64_vals[i].val);
+	}
+
+	return NL_SKIP;
+}
+
+static const char *export_ifname(__u32 ifindex)
+{
+	int i;
+
+	for (i = 0; i < export.ifaces.n; i++)
+		if (export_at(&export.ifaces, struct export_iface, i)->ifindex ==
+		    ifindex)
+			return export_at(&export.ifaces, struct export_iface,
+					 i)->name;
+	return iw_ifname(ifindex);
+}
+
+static void export_printf(const char *fmt, ...)
+{
+	va_list ap;
+	size_t size;
+	char *tmp;
+	int len;
+
+	for (;;) {
+		va_start(ap, fmt);
+		len = vsnprintf(export.doc + export.doc_len,
+				export.doc_size - export.doc_len, fmt, ap);
+		va_end(ap);
+		if (len < 0)
+			return;
+		if (export.doc_len + len < export.doc_size)
+			break;
+
+		size = export.doc_size ? 2 * export.doc_size : 16384;
+		while (size <= export.doc_len + len)
+			size *= 2;
+		tmp = realloc(export.doc, size);
+		if (!tmp)
+			return;
+		export.doc = tmp;
+		export.doc_size = size;
+	}
+
+	export.doc_len += len;
+}
+
+/*
+ * Label values need a backslash before a backslash, a double quote and
+ * a newline (as "\\n"). Interface names may well hold the first two.
+ */
+static const char *export_escape(const char *val)
+{
+	static char buf[2 * IF_NAMESIZE + 1];
+	char *p = buf;
+
+	for (; *val && p < buf + sizeof(buf) - 2; val++) {
+		if (*val == '\\' || *val == '"') {
+			*p++ = '\\';
+			*p++ = *val;
+		} else if (*val == '\n') {
+			*p++ = '\\';
+			*p++ = 'n';
+		} else
+			*p++ = *val;
+	}
+	*p = 0;
+	return buf;
+}
+
+static void export_family(const struct export_metric *m)
+{
+	export_printf("# HELP %s %s\n", m->name, m->help);
+	export_printf("# TYPE %s %s\n", m->name, m->type);
+}
+
+static void export_value(const struct export_metric *m, long long val)
+{
+	if (m->scale == 1)
+		export_printf(" %lld\n", val);
+	else
+		export_printf(" %lld.%03lld\n", val / m->scale,
+			      val % m->scale * 1000 / m->scale);
+}
+
+static void export_render(void)
+{
+	const struct export_metric *m;
+	struct export_iface *iface;
+	struct export_sta *sta;
+	struct export_survey *survey;
+	char mac_addr[20];
+	int i, v;
+
+	export.doc_len = 0;
+
+	export_printf("# HELP iw_interface_info Wireless interface.\n"
+		      "# TYPE iw_interface_info gauge\n");
+	for (i = 0; i < export.ifaces.n; i++) {
+		iface = export_at(&export.ifaces, struct export_iface, i);
+		export_printf("iw_interface_info{ifname=\"%s\",phy=\"%u\",type=\"%s\"} 1\n",
+			      export_escape(iface->name), iface->wiphy,
+			      iftype_name(iface->iftype));
+	}
+	export_printf("# HELP iw_interface_frequency_hertz Operating frequency.\n"
+		      "# TYPE iw_interface_frequency_hertz gauge\n");
+	for (i = 0; i < export.ifaces.n; i++) {
+		iface = export_at(&export.ifaces, struct export_iface, i);
+		if (iface->freq)
+			export_printf("iw_interface_frequency_hertz{ifname=\"%s\"} %u000000\n",
+				      export_escape(iface->name), iface->freq);
+	}
+
+	/* the samples of a family must be together */
+	for (v = 0; v < __EXPORT_STA_NUM; v++) {
+		m = &export_sta_metrics[v];
+		export_family(m);
+		for (i = 0; i < export.stas.n; i++) {
+			sta = export_at(&export.stas, struct export_sta, i);
+			if (!(sta->present & BIT(v)))
+				continue;
+			mac_addr_n2a(mac_addr, sta->mac);
+			export_printf("%s%s{ifname=\"%s\",mac=\"%s\"}", m->name,
+				      strcmp(m->type, "counter") ? "" : "_total",
+				      export_escape(export_ifname(sta->ifindex)),
+				      mac_addr);
+			export_value(m, sta->val[v]);
+		}
+	}
+
+	export_printf("# HELP iw_survey_in_use Channel currently in use.\n"
+		      "# TYPE iw_survey_in_use gauge\n");
+	for (i = 0; i < export.surveys.n; i++) {
+		survey = export_at(&export.surveys, struct export_survey, i);
+		export_printf("iw_survey_in_use{ifname=\"%s\",frequency=\"%u\"} %d\n",
+			      export_escape(export_ifname(survey->ifindex)),
+			      survey->freq, survey->in_use);
+	}
+	for (v = 0; v < __EXPORT_SURVEY_NUM; v++) {
+		m = &export_survey_metrics[v];
+		export_family(m);
+		for (i = 0; i < export.surveys.n; i++) {
+			survey = export_at(&export.surveys,
+					   struct export_survey, i);
+			if (!(survey->present & BIT(v)))
+				continue;
+			export_printf("%s%s{ifname=\"%s\",frequency=\"%u\"}",
+				      m->name,
+				      strcmp(m->type, "counter") ? "" : "_total",
+				      export_escape(export_ifname(survey->ifindex)),
+				      survey->freq);
+			export_value(m, survey->val[v]);
+		}
+	}
+
+	export_printf("# HELP iw_export_collections Times the dumps were done.\n"
+		      "# TYPE iw_export_collections counter\n"
+		      "iw_export_collections_total %llu\n"
+		      "# HELP iw_export_errors Dumps that failed.\n"
+		      "# TYPE iw_export_errors counter\n"
+		      "iw_export_errors_total %llu\n"
+		      "# HELP iw_export_collect_duration_seconds Time the last dumps took.\n"
+		      "# TYPE iw_export_collect_duration_seconds gauge\n"
+		      "iw_export_collect_duration_seconds %llu.%06llu\n"
+		      "# EOF\n",
+		      export.collections, export.errors,
+		      export.duration_us / 1000000,
+		      export.duration_us % 1000000);
+}
+
+/*
+ * Not every interface type has stations and not every driver does
+ * surveys, and an interface may be gone by now: that's no error, and
+ * not worth failing the scrape either.
+ */
+static void export_dump_more(__u8 cmd, __u32 ifindex,
+			     int (*handler)(struct nl_msg *msg, void *arg))
+{
+	int err = export_dump(cmd, ifindex, handler);
+
+	if (err && err != -EOPNOTSUPP && err != -ENODEV)
+		export.errors++;
+}
+
+static int export_collect(void)
+{
+	struct export_iface *iface;
+	unsigned long long start = export_now_us();
+	int err, i, j;
+
+	export.ifaces.n = 0;
+	export.stas.n = 0;
+	export.surveys.n = 0;
+	export.collections++;
+
+	err = export_dump(NL80211_CMD_GET_INTERFACE, 0, export_iface_handler);
+	if (err) {
+		export.errors++;
+		return err;
+	}
+
+	for (i = 0; i < export.ifaces.n; i++) {
+		iface = export_at(&export.ifaces, struct export_iface, i);
+
+		export_dump_more(NL80211_CMD_GET_STATION, iface->ifindex,
+				 export_sta_handler);
+
+		/* the survey is per radio, the first interface does */
+		for (j = 0; j < i; j++)
+			if (export_at(&export.ifaces, struct export_iface,
+				      j)->wiphy == iface->wiphy)
+				break;
+		if (j == i)
+			export_dump_more(NL80211_CMD_GET_SURVEY, iface->ifindex,
+					 export_survey_handler);
+	}
+
+	export.duration_us = export_now_us() - start;
+	export_render();
+	return 0;
+}
+
+static void export_client_close(int idx)
+{
+	struct export_client *c = &export.clients[idx];
+
+	close(c->fd);
+	free(c->resp);
+	export.clients[idx] = export.clients[--export.n_clients];
+}
+
+static void export_respond(struct export_client *c, const char *status,
+			   const char *type, const char *body, size_t len)
+{
+	char hdr[256];
+	int hlen;
+
+	hlen = snprintf(hdr, sizeof(hdr),
+			"HTTP/1.1 %s\r\n"
+			"Content-Type: %s\r\n"
+			"Content-Length: %zu\r\n"
+			"Connection: close\r\n\r\n",
+			status, type, len);
+
+	c->resp = malloc(hlen + len);
+	if (!c->resp)
+		return;
+	memcpy(c->resp, hdr, hlen);
+	memcpy(c->resp + hlen, body, len);
+	c->resp_len = hlen + len;
+	c->resp_off = 0;
+}
+
+static void export_handle_request(struct export_client *c)
+{
+	unsigned long long now = export_now_us() / 1000;
+	char method[8], path[64];
+	const char *msg;
+
+	if (sscanf(c->req, "%7s %63s", method, path) != 2) {
+		msg = "bad request\n";
+		export_respond(c, "400 Bad Request", "text/plain",
+			       msg, strlen(msg));
+		return;
+	}
+	if (strcmp(method, "GET")) {
+		msg = "only GET\n";
+		export_respond(c, "405 Method Not Allowed", "text/plain",
+			       msg, strlen(msg));
+		return;
+	}
+	if (strcmp(path, "/metrics") && strcmp(path, "/")) {
+		msg = "try /metrics\n";
+		export_respond(c, "404 Not Found", "text/plain",
+			       msg, strlen(msg));
+		return;
+	}
+
+	/* everything within the cache period gets the same document */
+	if (!export.valid || now - export.collected >= export.cache) {
+		export.valid = !export_collect();
+		export.collected = now;
+	}
+
+	if (!export.valid) {
+		msg = "nl80211 interface dump failed\n";
+		export_respond(c, "503 Service Unavailable", "text/plain",
+			       msg, strlen(msg));
+		return;
+	}
+
+	export_respond(c, "200 OK",
+		       "application/openmetrics-text; version=1.0.0; charset=utf-8",
+		       export.doc, export.doc_len);
+}
+
+/* returns false when the client is done with */
+static bool export_client_io(struct export_client *c, short revents)
+{
+	ssize_t n;
+
+	if (revents & (POLLERR | POLLHUP | POLLNVAL))
+		return false;
+
+	if (!c->resp && (revents & POLLIN)) {
+		n = recv(c->fd, c->req + c->req_len,
+			 sizeof(c->req) - 1 - c->req_len, 0);
+		if (n <= 0)
+			return n < 0 && errno == EAGAIN;
+		c->req_len += n;
+		c->req[c->req_len] = 0;
+
+		if (strstr(c->req, "\r\n\r\n") || strstr(c->req, "\n\n"))
+			export_handle_request(c);
+		else if (c->req_len == sizeof(c->req) - 1)
+			return false;
+		if (!c->resp)
+			return true;
+	}
+
+	if (c->resp) {
+		n = send(c->fd, c->resp + c->resp_off,
+			 c->resp_len - c->resp_off, MSG_NOSIGNAL);
+		if (n < 0)
+			return errno == EAGAIN;
+		c->resp_off += n;
+		return c->resp_off < c->resp_len;
+	}
+
+	return true;
+}
+
+static bool export_loopback(const struct sockaddr *sa)
+{
+	const struct sockaddr_in *sin = (const struct sockaddr_in *)sa;
+	const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)sa;
+	const __u8 *a6 = sin6->sin6_addr.s6_addr;
+
+	if (sa->sa_family == AF_INET)
+		return (ntohl(sin->sin_addr.s_addr) >> 24) == 127;
+	if (sa->sa_family != AF_INET6)
+		return false;
+	if (IN6_IS_ADDR_LOOPBACK(&sin6->sin6_addr))
+		return true;
+	/* ::ffff:127.x.x.x */
+	return IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr) && a6[12] == 127;
+}
+
+/* -EPERM for an address that isn't loopback, unless that is allowed */
+static int export_listen(const char *addr, bool remote)
+{
+	struct addrinfo hints, *ai;
+	char buf[128], *host = buf, *port;
+	int fd, err, one = 1;
+
+	if (snprintf(buf, sizeof(buf), "%s", addr) >= (int)sizeof(buf))
+		return -EINVAL;
+
+	/* "127.0.0.1:9100" or "[::1]:9100" */
+	port = strrchr(buf, ':');
+	if (!port)
+		return -EINVAL;
+	*port++ = 0;
+	if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+		host++;
+		host[strlen(host) - 1] = 0;
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;
+	if (getaddrinfo(host, port, &hints, &ai))
+		return -EINVAL;
+
+	if (!remote && !export_loopback(ai->ai_addr)) {
+		err = -EPERM;
+		goto out;
+	}
+
+	fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK,
+		    ai->ai_protocol);
+	if (fd < 0) {
+		err = -errno;
+		goto out;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, ai->ai_addr, ai->ai_addrlen) ||
+	    listen(fd, EXPORT_MAX_CLIENTS)) {
+		err = -errno;
+		close(fd);
+		goto out;
+	}
+	err = fd;
+ out:
+	freeaddrinfo(ai);
+	return err;
+}
+
+static int handle_export(struct nl80211_state *state,
+			 struct nl_cb *cb,
+			 struct nl_msg *msg,
+			 int argc, char **argv,
+			 enum id_input id)
+{
+	struct pollfd pfd[EXPORT_MAX_CLIENTS + 1];
+	struct export_client *c;
+	unsigned long long now;
+	char *listen_addr = NULL, *end;
+	bool remote = false;
+	int lfd, fd, i, n;
+
+	memset(&export, 0, sizeof(export));
+	export.state = state;
+	export.cache = 1000;
+
+	/* "export --listen <addr>:<port> [--cache <ms>] [--allow-remote]" */
+	for (argc--, argv++; argc; argc--, argv++) {
+		if (strcmp(argv[0], "--allow-remote") == 0) {
+			remote = true;
+			continue;
+		}
+		if (argc < 2)
+			return 1;
+		if (strcmp(argv[0], "--listen") == 0) {
+			listen_addr = argv[1];
+		} else if (strcmp(argv[0], "--cache") == 0) {
+			export.cache = strtoul(argv[1], &end, 10);
+			if (*end)
+				return 1;
+		} else
+			return 1;
+		argc--;
+		argv++;
+	}
+	if (!listen_addr)
+		return 1;
+
+	lfd = export_listen(listen_addr, remote);
+	if (lfd == -EPERM) {
+		fprintf(stderr, "%s is not a loopback address, see --allow-remote\n",
+			listen_addr);
+		return 2;
+	}
+	if (lfd < 0) {
+		fprintf(stderr, "cannot listen on %s: %s\n", listen_addr,
+			strerror(-lfd));
+		return 2;
+	}
+
+	for (;;) {
+		pfd[0].fd = lfd;
+		pfd[0].events = export.n_clients < EXPORT_MAX_CLIENTS ? POLLIN : 0;
+		for (i = 0; i < export.n_clients; i++) {
+			pfd[i + 1].fd = export.clients[i].fd;
+			pfd[i + 1].events = export.clients[i].resp ? POLLOUT
+								   : POLLIN;
+		}
+		n = export.n_clients;
+
+		if (poll(pfd, n + 1, 1000) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		now = export_now_us() / 1000;
+
+		/* backwards, closing a client moves the last one into its slot */
+		for (i = n - 1; i >= 0; i--) {
+			c = &export.clients[i];
+			if (pfd[i + 1].revents &&
+			    !export_client_io(c, pfd[i + 1].revents))
+				export_client_close(i);
+			else if (now - c->since > EXPORT_CLIENT_TIMEOUT)
+				export_client_close(i);
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			fd = accept(lfd, NULL, NULL);
+			if (fd < 0)
+				continue;
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+			c = &export.clients[export.n_clients++];
+			memset(c, 0, sizeof(*c));
+			c->fd = fd;
+			c->since = now;
+		}
+	}
+
+	close(lfd);
+	return -errno;
+}
+TOPLEVEL(export, "--listen <addr>:<port> [--cache <ms>] [--allow-remote]", 0, 0,
+	 CIB_NONE, handle_export,
+	 "Serve the interface, station and survey data of all wireless\n"
+	 "interfaces as OpenMetrics on http://<addr>:<port>/metrics, for a\n"
+	 "Prometheus scraper. There's no authentication, so <addr> must be\n"
+	 "a loopback address, e.g. 127.0.0.1:9100 or [::1]:9100, unless\n"
+	 "--allow-remote is given.\n"
+	 "The dumps are done at most once every <ms> milliseconds (default\n"
+	 "1000), however many scrapers there are.");
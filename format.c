@@ -0,0 +1,340 @@
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "iw.h"
+
+/*
+ * Machine readable output for the dump commands (--format json|cbor).
+ *
+ * The writers stream: every value goes to stdout as soon as it is
+ * emitted and only the nesting state is kept, so even a large dump is
+ * never held in memory as a whole. The document is an array with one
+ * object per netlink message, opened by the first object and closed by
+ * fmt_finish(). CBOR uses indefinite length arrays and maps for this.
+ */
+
+enum iw_format iw_format = IW_FORMAT_TEXT;
+
+#define FMT_MAX_DEPTH	16
+
+static struct {
+	bool started;
+	int depth;
+	bool first[FMT_MAX_DEPTH];
+	char open[FMT_MAX_DEPTH];	/* JSON closing bracket */
+} fmt;
+
+int parse_format(const char *name)
+{
+	if (strcmp(name, "text") == 0)
+		iw_format = IW_FORMAT_TEXT;
+	else if (strcmp(name, "json") == 0)
+		iw_format = IW_FORMAT_JSON;
+	else if (strcmp(name, "cbor") == 0)
+		iw_format = IW_FORMAT_CBOR;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+static void cbor_head(__u8 major, unsigned long long val)
+{
+	int i, n;
+
+	major <<= 5;
+	if (val < 24) {
+		putchar(major | val);
+		return;
+	} else if (val <= 0xff) {
+		putchar(major | 24);
+		n = 1;
+	} else if (val <= 0xffff) {
+		putchar(major | 25);
+		n = 2;
+	} else if (val <= 0xffffffff) {
+		putchar(major | 26);
+		n = 4;
+	} else {
+		putchar(major | 27);
+		n = 8;
+	}
+
+	for (i = n - 1; i >= 0; i--)
+		putchar((val >> (8 * i)) & 0xff);
+}
+
+/* length of the UTF-8 sequence at str, 0 if it isn't a valid one */
+static int utf8_seq(const unsigned char *str, int len)
+{
+	unsigned int cp, min;
+	int n, i;
+
+	if (str[0] < 0x80)
+		return 1;
+	else if ((str[0] & 0xe0) == 0xc0) {
+		n = 2;
+		cp = str[0] & 0x1f;
+		min = 0x80;
+	} else if ((str[0] & 0xf0) == 0xe0) {
+		n = 3;
+		cp = str[0] & 0x0f;
+		min = 0x800;
+	} else if ((str[0] & 0xf8) == 0xf0) {
+		n = 4;
+		cp = str[0] & 0x07;
+		min = 0x10000;
+	} else
+		return 0;
+
+	if (n > len)
+		return 0;
+	for (i = 1; i < n; i++) {
+		if ((str[i] & 0xc0) != 0x80)
+			return 0;
+		cp = cp << 6 | (str[i] & 0x3f);
+	}
+
+	/* no overlong forms, surrogates or code points past U+10FFFF */
+	if (cp < min || (cp >= 0xd800 && cp <= 0xdfff) || cp > 0x10ffff)
+		return 0;
+	return n;
+}
+
+static bool utf8_valid(const char *str, int len)
+{
+	int i, n;
+
+	for (i = 0; i < len; i += n) {
+		n = utf8_seq((const unsigned char *)str + i, len - i);
+		if (!n)
+			return false;
+	}
+	return true;
+}
+
+static void json_string(const char *str, int len)
+{
+	int i, n;
+
+	putchar('"');
+	for (i = 0; i < len; i += n) {
+		unsigned char c = str[i];
+
+		n = utf8_seq((const unsigned char *)str + i, len - i);
+		if (c == '"' || c == '\\')
+			printf("\\%c", c);
+		else if (c < 0x20 || c == 0x7f)
+			printf("\\u%04x", c);
+		else if (n)
+			fwrite(str + i, 1, n, stdout);
+		else
+			/* not UTF-8, keep the JSON valid at least */
+			printf("\\u%04x", c);
+		if (!n)
+			n = 1;
+	}
+	putchar('"');
+}
+
+static void fmt_string(const char *str, int len)
+{
+	if (iw_format == IW_FORMAT_CBOR) {
+		cbor_head(3, len);
+		fwrite(str, 1, len, stdout);
+	} else
+		json_string(str, len);
+}
+
+/* start a new value: separator and key as needed in the current container */
+static void fmt_value(const char *key)
+{
+	if (!fmt.started) {
+		fmt.started = true;
+		fmt.depth = 1;
+		fmt.first[1] = true;
+		if (iw_format == IW_FORMAT_CBOR)
+			putchar(0x9f);
+		else
+			putchar('[');
+	}
+
+	if (iw_format == IW_FORMAT_JSON) {
+		if (!fmt.first[fmt.depth])
+			putchar(',');
+		/* one top-level object per line */
+		if (fmt.depth == 1)
+			putchar('\n');
+	}
+	fmt.first[fmt.depth] = false;
+
+	if (key && fmt.depth > 1) {
+		fmt_string(key, strlen(key));
+		if (iw_format == IW_FORMAT_JSON)
+			putchar(':');
+	}
+}
+
+static void fmt_open(const char *key, __u8 cbor, char json)
+{
+	fmt_value(key);
+	if (iw_format == IW_FORMAT_CBOR)
+		putchar(cbor);
+	else
+		putchar(json);
+	if (fmt.depth < FMT_MAX_DEPTH - 1)
+		fmt.depth++;
+	fmt.first[fmt.depth] = true;
+	fmt.open[fmt.depth] = json == '{' ? '}' : ']';
+}
+
+static void fmt_close(char json)
+{
+	if (iw_format == IW_FORMAT_CBOR)
+		putchar(0xff);
+	else
+		putchar(json);
+	if (fmt.depth > 1)
+		fmt.depth--;
+}
+
+void fmt_obj_begin(const char *key)
+{
+	fmt_open(key, 0xbf, '{');
+}
+
+void fmt_obj_end(void)
+{
+	fmt_close('}');
+}
+
+void fmt_arr_begin(const char *key)
+{
+	fmt_open(key, 0x9f, '[');
+}
+
+void fmt_arr_end(void)
+{
+	fmt_close(']');
+}
+
+void fmt_int(const char *key, long long val)
+{
+	fmt_value(key);
+	if (iw_format == IW_FORMAT_CBOR) {
+		if (val < 0)
+			cbor_head(1, -1 - val);
+		else
+			cbor_head(0, val);
+	} else
+		printf("%lld", val);
+}
+
+void fmt_uint(const char *key, unsigned long long val)
+{
+	fmt_value(key);
+	if (iw_format == IW_FORMAT_CBOR)
+		cbor_head(0, val);
+	else
+		printf("%llu", val);
+}
+
+void fmt_bool(const char *key, bool val)
+{
+	fmt_value(key);
+	if (iw_format == IW_FORMAT_CBOR)
+		putchar(val ? 0xf5 : 0xf4);
+	else
+		printf(val ? "true" : "false");
+}
+
+void fmt_strn(const char *key, const char *val, int len)
+{
+	fmt_value(key);
+	fmt_string(val, len);
+}
+
+void fmt_str(const char *key, const char *val)
+{
+	fmt_strn(key, val, strlen(val));
+}
+
+/* raw bytes: a CBOR byte string, hex in JSON */
+void fmt_bytes(const char *key, const __u8 *val, int len)
+{
+	int i;
+
+	fmt_value(key);
+	if (iw_format == IW_FORMAT_CBOR) {
+		cbor_head(2, len);
+		fwrite(val, 1, len, stdout);
+		return;
+	}
+
+	putchar('"');
+	for (i = 0; i < len; i++)
+		printf("%02x", val[i]);
+	putchar('"');
+}
+
+/*
+ * An SSID is just bytes. CBOR has byte strings for that; JSON gets it
+ * as a string if it is UTF-8 (as it mostly is), and as hex in a
+ * "<key>_hex" member otherwise.
+ */
+void fmt_ssid(const char *key, const __u8 *ssid, int len)
+{
+	char hex_key[64];
+
+	if (iw_format == IW_FORMAT_CBOR) {
+		fmt_bytes(key, ssid, len);
+		return;
+	}
+	if (utf8_valid((const char *)ssid, len)) {
+		fmt_strn(key, (const char *)ssid, len);
+		return;
+	}
+
+	snprintf(hex_key, sizeof(hex_key), "%s_hex", key);
+	fmt_bytes(hex_key, ssid, len);
+}
+
+void fmt_mac(const char *key, const unsigned char *addr)
+{
+	char buf[20];
+
+	mac_addr_n2a(buf, (unsigned char *)addr);
+	fmt_str(key, buf);
+}
+
+/*
+ * Close the document. If nothing was emitted, an empty one is written
+ * only for a command that completed, so errors don't look like data.
+ */
+void fmt_finish(bool complete)
+{
+	if (!fmt.started) {
+		if (!complete)
+			return;
+		fmt.started = true;
+		fmt.first[1] = true;
+		if (iw_format == IW_FORMAT_CBOR)
+			putchar(0x9f);
+		else
+			putchar('[');
+	}
+
+	/* a handler may have bailed out in the middle of an object */
+	while (fmt.depth > 1)
+		fmt_close(fmt.open[fmt.depth]);
+
+	if (iw_format == IW_FORMAT_CBOR) {
+		putchar(0xff);
+	} else {
+		if (!fmt.first[1])
+			putchar('\n');
+		printf("]\n");
+	}
+	fflush(stdout);
+	fmt.started = false;
+}
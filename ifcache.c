@@ -0,0 +1,211 @@
+#include <net/if.h>
+#include <errno.h>
+#include <string.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl80211.h"
+#include "iw.h"
+
+/*
+ * ifindex -> name cache for the printers, so that dumps and events
+ * don't need an if_indextoname() ioctl for every single message.
+ *
+ * Every entry is allocated on its own so that the names handed out
+ * stay put when the cache grows; a printer may well hold on to one
+ * while looking up the next.
+ */
+
+struct ifcache iw_ifcache;
+
+static struct ifcache_entry *ifcache_find(struct ifcache *cache,
+					  __u32 ifindex)
+{
+	int i;
+
+	for (i = 0; i < cache->n_entries; i++)
+		if (cache->entries[i]->ifindex == ifindex)
+			return cache->entries[i];
+
+	return NULL;
+}
+
+static struct ifcache_entry *ifcache_set(struct ifcache *cache,
+					 __u32 ifindex, const char *name)
+{
+	struct ifcache_entry *entry = ifcache_find(cache, ifindex);
+
+	if (!entry) {
+		if (cache->n_entries == cache->size) {
+			int size = cache->size ? 2 * cache->size : 8;
+			struct ifcache_entry **entries;
+
+			entries = realloc(cache->entries,
+					  size * sizeof(*entries));
+			if (!entries)
+				return NULL;
+			cache->entries = entries;
+			cache->size = size;
+		}
+		entry = malloc(sizeof(*entry));
+		if (!entry)
+			return NULL;
+		entry->ifindex = ifindex;
+		cache->entries[cache->n_entries++] = entry;
+	}
+
+	strncpy(entry->name, name, sizeof(entry->name) - 1);
+	entry->name[sizeof(entry->name) - 1] = '\0';
+	return entry;
+}
+
+static void ifcache_del(struct ifcache *cache, __u32 ifindex)
+{
+	int i;
+
+	for (i = 0; i < cache->n_entries; i++) {
+		if (cache->entries[i]->ifindex != ifindex)
+			continue;
+		free(cache->entries[i]);
+		cache->entries[i] = cache->entries[--cache->n_entries];
+		return;
+	}
+}
+
+const char *ifcache_name(struct ifcache *cache, __u32 ifindex)
+{
+	/* a few of them, for more than one unknown name per printf() */
+	static char bufs[4][IF_NAMESIZE + 10];
+	static int next;
+	struct ifcache_entry *entry = ifcache_find(cache, ifindex);
+	char *buf;
+
+	if (entry)
+		return entry->name;
+
+	buf = bufs[next++ % ARRAY_SIZE(bufs)];
+
+	/* not known (yet), ask the kernel and remember it */
+	if (!cache->no_lookup && if_indextoname(ifindex, buf)) {
+		entry = ifcache_set(cache, ifindex, buf);
+		return entry ? entry->name : buf;
+	}
+
+	snprintf(buf, sizeof(bufs[0]), "if#%u", ifindex);
+	return buf;
+}
+
+const char *iw_ifname(__u32 ifindex)
+{
+	return ifcache_name(&iw_ifcache, ifindex);
+}
+
+void ifcache_event(struct ifcache *cache, __u8 cmd, struct nlattr **tb)
+{
+	__u32 ifindex;
+
+	if (!tb[NL80211_ATTR_IFINDEX])
+		return;
+
+	ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+
+	switch (cmd) {
+	case NL80211_CMD_NEW_INTERFACE:
+	case NL80211_CMD_SET_INTERFACE:
+		if (tb[NL80211_ATTR_IFNAME])
+			ifcache_set(cache, ifindex,
+				    nla_get_string(tb[NL80211_ATTR_IFNAME]));
+		break;
+	case NL80211_CMD_DEL_INTERFACE:
+		ifcache_del(cache, ifindex);
+		break;
+	default:
+		break;
+	}
+}
+
+static int ifcache_dump_handler(struct nl_msg *msg, void *arg)
+{
+	struct ifcache *cache = arg;
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	ifcache_event(cache, NL80211_CMD_NEW_INTERFACE, tb);
+
+	return NL_SKIP;
+}
+
+static int error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
+			 void *arg)
+{
+	int *ret = arg;
+	*ret = err->error;
+	return NL_STOP;
+}
+
+static int finish_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+	*ret = 0;
+	return NL_SKIP;
+}
+
+/*
+ * Fill the cache from an nl80211 interface dump. This must be done
+ * before the socket joins any multicast groups.
+ */
+int ifcache_fill(struct ifcache *cache, struct nl80211_state *state)
+{
+	struct nl_msg *msg;
+	struct nl_cb *cb;
+	int err;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		return -ENOMEM;
+
+	cb = nl_cb_alloc(iw_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
+	if (!cb) {
+		err = -ENOMEM;
+		goto out_free_msg;
+	}
+
+	genlmsg_put(msg, 0, 0, state->nl80211_id, 0,
+		    NLM_F_DUMP, NL80211_CMD_GET_INTERFACE, 0);
+
+	err = nl_send_auto_complete(state->nl_sock, msg);
+	if (err < 0)
+		goto out;
+
+	err = 1;
+
+	nl_cb_err(cb, NL_CB_CUSTOM, error_handler, &err);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler, &err);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, ifcache_dump_handler, cache);
+
+	while (err > 0)
+		if (nl_recvmsgs(state->nl_sock, cb) < 0 && err > 0)
+			err = -EIO;
+ out:
+	nl_cb_put(cb);
+ out_free_msg:
+	nlmsg_free(msg);
+	return err;
+}
+
+void ifcache_free(struct ifcache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->n_entries; i++)
+		free(cache->entries[i]);
+	free(cache->entries);
+	memset(cache, 0, sizeof(*cache));
+}
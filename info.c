@@ -63,6 +63,69 @@ static char *dfs_state_name(enum nl80211_dfs_state state)
 	}
 }
 
+/*
+ * With split dumps a wiphy arrives in several messages, each of them
+ * becomes an object with what it carries; merge them by "phy".
+ */
+static void print_phy_fmt(struct nlattr **tb_msg,
+			  struct nla_policy *freq_policy)
+{
+	struct nlattr *tb_band[NL80211_BAND_ATTR_MAX + 1];
+	struct nlattr *tb_freq[NL80211_FREQUENCY_ATTR_MAX + 1];
+	struct nlattr *nl_band, *nl_freq;
+	int rem_band, rem_freq;
+	__u32 freq;
+
+	fmt_obj_begin(NULL);
+	if (tb_msg[NL80211_ATTR_WIPHY])
+		fmt_uint("phy", nla_get_u32(tb_msg[NL80211_ATTR_WIPHY]));
+	if (tb_msg[NL80211_ATTR_WIPHY_NAME])
+		fmt_str("name", nla_get_string(tb_msg[NL80211_ATTR_WIPHY_NAME]));
+
+	if (tb_msg[NL80211_ATTR_WIPHY_BANDS]) {
+		fmt_arr_begin("bands");
+		nla_for_each_nested(nl_band, tb_msg[NL80211_ATTR_WIPHY_BANDS], rem_band) {
+			nla_parse(tb_band, NL80211_BAND_ATTR_MAX, nla_data(nl_band),
+				  nla_len(nl_band), NULL);
+
+			fmt_obj_begin(NULL);
+			fmt_uint("band", nl_band->nla_type + 1);
+			if (tb_band[NL80211_BAND_ATTR_HT_CAPA])
+				fmt_uint("ht_capa",
+					 nla_get_u16(tb_band[NL80211_BAND_ATTR_HT_CAPA]));
+			if (tb_band[NL80211_BAND_ATTR_VHT_CAPA])
+				fmt_uint("vht_capa",
+					 nla_get_u32(tb_band[NL80211_BAND_ATTR_VHT_CAPA]));
+
+			if (tb_band[NL80211_BAND_ATTR_FREQS]) {
+				fmt_arr_begin("freqs");
+				nla_for_each_nested(nl_freq, tb_band[NL80211_BAND_ATTR_FREQS], rem_freq) {
+					nla_parse(tb_freq, NL80211_FREQUENCY_ATTR_MAX, nla_data(nl_freq),
+						  nla_len(nl_freq), freq_policy);
+					if (!tb_freq[NL80211_FREQUENCY_ATTR_FREQ])
+						continue;
+					freq = nla_get_u32(tb_freq[NL80211_FREQUENCY_ATTR_FREQ]);
+
+					fmt_obj_begin(NULL);
+					fmt_uint("freq", freq);
+					fmt_uint("channel", ieee80211_frequency_to_channel(freq));
+					if (tb_freq[NL80211_FREQUENCY_ATTR_MAX_TX_POWER])
+						fmt_uint("max_tx_power_mbm",
+							 nla_get_u32(tb_freq[NL80211_FREQUENCY_ATTR_MAX_TX_POWER]));
+					fmt_bool("disabled", !!tb_freq[NL80211_FREQUENCY_ATTR_DISABLED]);
+					fmt_bool("no_ir", !!tb_freq[NL80211_FREQUENCY_ATTR_NO_IR]);
+					fmt_bool("radar", !!tb_freq[NL80211_FREQUENCY_ATTR_RADAR]);
+					fmt_obj_end();
+				}
+				fmt_arr_end();
+			}
+			fmt_obj_end();
+		}
+		fmt_arr_end();
+	}
+	fmt_obj_end();
+}
+
 static int print_phy_handler(struct nl_msg *msg, void *arg)
 {
 	struct nlattr *tb_msg[NL80211_ATTR_MAX + 1];
@@ -109,6 +172,11 @@ static int print_phy_handler(struct nl_msg *msg, void *arg)
 	nla_parse(tb_msg, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
 		  genlmsg_attrlen(gnlh, 0), NULL);
 
+	if (iw_format != IW_FORMAT_TEXT) {
+		print_phy_fmt(tb_msg, freq_policy);
+		return NL_SKIP;
+	}
+
 	if (tb_msg[NL80211_ATTR_WIPHY]) {
 		if (nla_get_u32(tb_msg[NL80211_ATTR_WIPHY]) == phy_id)
 			print_name = false;
@@ -643,10 +711,13 @@ static int handle_info(struct nl80211_state *state,
 	return 0;
 }
 __COMMAND(NULL, info, "info", NULL, NL80211_CMD_GET_WIPHY, 0, 0, CIB_PHY, handle_info,
-	 "Show capabilities for the specified wireless device.", NULL);
+	 "Show capabilities for the specified wireless device.", NULL,
+	 .formats = true);
 TOPLEVEL(list, NULL, NL80211_CMD_GET_WIPHY, NLM_F_DUMP, CIB_NONE, handle_info,
-	 "List all wireless devices and their capabilities.");
-TOPLEVEL(phy, NULL, NL80211_CMD_GET_WIPHY, NLM_F_DUMP, CIB_NONE, handle_info, NULL);
+	 "List all wireless devices and their capabilities.",
+	 .formats = true);
+TOPLEVEL(phy, NULL, NL80211_CMD_GET_WIPHY, NLM_F_DUMP, CIB_NONE, handle_info, NULL,
+.formats = true);
 
 static int handle_commands(struct nl80211_state *state,
 			   struct nl_cb *cb, struct nl_msg *msg,
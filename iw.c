@@ -44,7 +44,7 @@ static inline int nl_socket_set_buffer_size(struct nl_sock *sk,
 
 int iw_debug = 0;
 
-static int nl80211_init(struct nl80211_state *state)
+int nl80211_init(struct nl80211_state *state)
 {
 	int err;
 
@@ -76,7 +76,7 @@ static int nl80211_init(struct nl80211_state *state)
 	return err;
 }
 
-static void nl80211_cleanup(struct nl80211_state *state)
+void nl80211_cleanup(struct nl80211_state *state)
 {
 	nl_socket_free(state->nl_sock);
 }
@@ -176,6 +176,9 @@ static void usage_options(void)
 {
 	printf("Options:\n");
 	printf("\t--debug\t\tenable netlink debugging\n");
+	printf("\t--format <text|json|cbor>\n"
+	       "\t\t\tmachine readable output for the scan, station,\n"
+	       "\t\t\tsurvey, reg and phy dumps\n");
 }
 
 static const char *argv0;
@@ -301,7 +304,7 @@ static int __handle_cmd(struct nl80211_state *state, enum id_input idby,
 	struct nl_cb *s_cb;
 	struct nl_msg *msg;
 	signed long long devidx = 0;
-	int err, o_argc;
+	int err, o_argc, rank, best = 0;
 	const char *command, *section;
 	char *tmp, **o_argv;
 	enum command_identify_by command_idby = CIB_NONE;
@@ -353,14 +356,27 @@ static int __handle_cmd(struct nl80211_state *state, enum id_input idby,
 	argc--;
 	argv++;
 
+	/*
+	 * A section name may be used more than once with different ways of
+	 * identifying the device ('info', 'scan'). Take the one that fits
+	 * best, so the result doesn't depend on the link order.
+	 */
 	for_each_cmd(sectcmd) {
 		if (sectcmd->parent)
 			continue;
-		/* ok ... bit of a hack for the dupe 'info' section */
-		if (match && sectcmd->idby != command_idby)
+		if (strcmp(sectcmd->name, section))
 			continue;
-		if (strcmp(sectcmd->name, section) == 0)
+		if (sectcmd->idby == command_idby)
+			rank = 2;
+		else if (sectcmd->idby == CIB_NETDEV &&
+			 command_idby == CIB_WDEV)
+			rank = 1;
+		else
+			rank = 0;
+		if (!match || rank > best) {
 			match = sectcmd;
+			best = rank;
+		}
 	}
 
 	sectcmd = match;
@@ -421,6 +437,11 @@ static int __handle_cmd(struct nl80211_state *state, enum id_input idby,
 	if (cmdout)
 		*cmdout = cmd;
 
+	if (cmdout && iw_format != IW_FORMAT_TEXT && !cmd->formats) {
+		fprintf(stderr, "command doesn't support --format\n");
+		return 2;
+	}
+
 	if (!cmd->cmd) {
 		argc = o_argc;
 		argv = o_argv;
@@ -504,17 +525,25 @@ int main(int argc, char **argv)
 	argc--;
 	argv0 = *argv++;
 
-	if (argc > 0 && strcmp(*argv, "--debug") == 0) {
-		iw_debug = 1;
+	while (argc > 0 && strncmp(*argv, "--", 2) == 0) {
+		if (strcmp(*argv, "--debug") == 0) {
+			iw_debug = 1;
+		} else if (strcmp(*argv, "--format") == 0) {
+			if (argc < 2 || parse_format(argv[1])) {
+				usage(0, NULL);
+				return 1;
+			}
+			argc--;
+			argv++;
+		} else if (strcmp(*argv, "--version") == 0) {
+			version();
+			return 0;
+		} else
+			break;
 		argc--;
 		argv++;
 	}
 
-	if (argc > 0 && strcmp(*argv, "--version") == 0) {
-		version();
-		return 0;
-	}
-
 	/* need to treat "help" command specially so it works w/o nl80211 */
 	if (argc == 0 || strcmp(*argv, "help") == 0) {
 		usage(argc - 1, argv + 1);
@@ -561,6 +590,9 @@ int main(int argc, char **argv)
 	} else if (err < 0)
 		fprintf(stderr, "command failed: %s (%d)\n", strerror(-err), err);
 
+	if (iw_format != IW_FORMAT_TEXT && cmd && cmd->formats)
+		fmt_finish(err == 0);
+
 	nl80211_cleanup(&nlstate);
 
 	return err;
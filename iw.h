@@ -2,11 +2,13 @@
 #define __IW_H
 
 #include <stdbool.h>
+#include <net/if.h>
 #include <netlink/netlink.h>
 #include <netlink/genl/genl.h>
 #include <netlink/genl/family.h>
 #include <netlink/genl/ctrl.h>
 #include <endian.h>
+#include <time.h>
 
 #include "nl80211.h"
 #include "ieee80211.h"
@@ -23,6 +25,9 @@ struct nl80211_state {
 	int nl80211_id;
 };
 
+int nl80211_init(struct nl80211_state *state);
+void nl80211_cleanup(struct nl80211_state *state);
+
 enum command_identify_by {
 	CIB_NONE,
 	CIB_PHY,
@@ -45,6 +50,7 @@ struct cmd {
 	const enum nl80211_commands cmd;
 	int nl_msg_flags;
 	int hidden;
+	bool formats; /* has --format json|cbor output */
 	const enum command_identify_by idby;
 	/*
 	 * The handler should return a negative error code,
@@ -63,7 +69,11 @@ struct cmd {
 #define ARRAY_SIZE(ar) (sizeof(ar)/sizeof(ar[0]))
 #define DIV_ROUND_UP(x, y) (((x) + (y - 1)) / (y))
 
-#define __COMMAND(_section, _symname, _name, _args, _nlcmd, _flags, _hidden, _idby, _handler, _help, _sel)\
+/*
+ * Anything after the regular arguments goes into the initializer, e.g.
+ * ".formats = true" for a command with structured output.
+ */
+#define __COMMAND(_section, _symname, _name, _args, _nlcmd, _flags, _hidden, _idby, _handler, _help, _sel, ...)\
 	static struct cmd						\
 	__cmd ## _ ## _symname ## _ ## _handler ## _ ## _nlcmd ## _ ## _idby ## _ ## _hidden\
 	__attribute__((used)) __attribute__((section("__cmd")))	= {	\
@@ -77,18 +87,19 @@ struct cmd {
 		.help = (_help),					\
 		.parent = _section,					\
 		.selector = (_sel),					\
+		__VA_ARGS__						\
 	}
-#define __ACMD(_section, _symname, _name, _args, _nlcmd, _flags, _hidden, _idby, _handler, _help, _sel, _alias)\
-	__COMMAND(_section, _symname, _name, _args, _nlcmd, _flags, _hidden, _idby, _handler, _help, _sel);\
+#define __ACMD(_section, _symname, _name, _args, _nlcmd, _flags, _hidden, _idby, _handler, _help, _sel, _alias, ...)\
+	__COMMAND(_section, _symname, _name, _args, _nlcmd, _flags, _hidden, _idby, _handler, _help, _sel, __VA_ARGS__);\
 	static const struct cmd *_alias = &__cmd ## _ ## _symname ## _ ## _handler ## _ ## _nlcmd ## _ ## _idby ## _ ## _hidden
-#define COMMAND(section, name, args, cmd, flags, idby, handler, help)	\
-	__COMMAND(&(__section ## _ ## section), name, #name, args, cmd, flags, 0, idby, handler, help, NULL)
-#define COMMAND_ALIAS(section, name, args, cmd, flags, idby, handler, help, selector, alias)\
-	__ACMD(&(__section ## _ ## section), name, #name, args, cmd, flags, 0, idby, handler, help, selector, alias)
+#define COMMAND(section, name, args, cmd, flags, idby, handler, help, ...)	\
+	__COMMAND(&(__section ## _ ## section), name, #name, args, cmd, flags, 0, idby, handler, help, NULL, __VA_ARGS__)
+#define COMMAND_ALIAS(section, name, args, cmd, flags, idby, handler, help, selector, alias, ...)\
+	__ACMD(&(__section ## _ ## section), name, #name, args, cmd, flags, 0, idby, handler, help, selector, alias, __VA_ARGS__)
 #define HIDDEN(section, name, args, cmd, flags, idby, handler)		\
 	__COMMAND(&(__section ## _ ## section), name, #name, args, cmd, flags, 1, idby, handler, NULL, NULL)
 
-#define TOPLEVEL(_name, _args, _nlcmd, _flags, _idby, _handler, _help)	\
+#define TOPLEVEL(_name, _args, _nlcmd, _flags, _idby, _handler, _help, ...)	\
 	struct cmd							\
 	__section ## _ ## _name						\
 	__attribute__((used)) __attribute__((section("__cmd")))	= {	\
@@ -99,6 +110,7 @@ struct cmd {
 		.idby = (_idby),					\
 		.handler = (_handler),					\
 		.help = (_help),					\
+		__VA_ARGS__						\
 	 }
 #define SECTION(_name)							\
 	struct cmd __section ## _ ## _name				\
@@ -118,24 +130,63 @@ int handle_cmd(struct nl80211_state *state, enum id_input idby,
 	       int argc, char **argv);
 
 struct print_event_args {
-	struct timeval ts; /* internal */
+	struct timespec ts; /* internal */
 	bool have_ts; /* must be set false */
 	bool frame, time, reltime;
+	clockid_t clock; /* CLOCK_REALTIME unless set */
+	const char *netns; /* namespace tag to print, if any */
+	struct ifcache *ifcache; /* NULL for the default cache */
+	/* if set, its ts and have_ts are used, so they can be shared */
+	struct print_event_args *parent;
+};
+
+struct wait_opts {
+	unsigned int timeout; /* in ms, 0 waits forever */
+	unsigned int elapsed; /* output: time spent waiting, in ms */
+	/* if set, only events for which this returns true end the wait */
+	bool (*match)(struct nl_msg *msg, void *priv);
+	void *priv;
 };
 
+/*
+ * The wait functions return the command that was received, 0 if the
+ * timeout expired first, or a negative error code (as an int).
+ */
 __u32 listen_events(struct nl80211_state *state,
-		    const int n_waits, const __u32 *waits);
+		    const int n_waits, const __u32 *waits,
+		    struct wait_opts *opts);
 int __prepare_listen_events(struct nl80211_state *state);
 __u32 __do_listen_events(struct nl80211_state *state,
 			 const int n_waits, const __u32 *waits,
-			 struct print_event_args *args);
+			 struct print_event_args *args,
+			 struct wait_opts *opts);
+
+
+struct ifcache_entry {
+	__u32 ifindex;
+	char name[IF_NAMESIZE];
+};
+
+struct ifcache {
+	struct ifcache_entry **entries;
+	int n_entries, size;
+	bool no_lookup; /* foreign netns, don't ask if_indextoname() */
+};
 
+extern struct ifcache iw_ifcache;
+
+const char *ifcache_name(struct ifcache *cache, __u32 ifindex);
+const char *iw_ifname(__u32 ifindex);
+void ifcache_event(struct ifcache *cache, __u8 cmd, struct nlattr **tb);
+int ifcache_fill(struct ifcache *cache, struct nl80211_state *state);
+void ifcache_free(struct ifcache *cache);
 
 int mac_addr_a2n(unsigned char *mac_addr, char *arg);
 void mac_addr_n2a(char *mac_addr, unsigned char *arg);
 int parse_hex_mask(char *hexmask, unsigned char **result, size_t *result_len,
 		   unsigned char **mask);
 unsigned char *parse_hex(char *hex, size_t *outlen);
+int parse_timeout(const char *arg, unsigned int *timeout);
 
 int parse_keys(struct nl_msg *msg, char **argv, int argc);
 
@@ -167,9 +218,163 @@ enum print_ie_type {
 
 #define BIT(x) (1ULL<<(x))
 
+struct ie_print {
+	const char *name;
+	void (*print)(const uint8_t type, uint8_t len, const uint8_t *data);
+	uint8_t minlen, maxlen;
+	uint8_t flags;	/* BIT(enum print_ie_type) */
+};
+
+/*
+ * A printer for vendor specific elements with the given OUI and vendor
+ * type (the byte after the OUI); the data passed to it starts after
+ * the type. The structure is linked into a table and must stay around.
+ */
+struct vendor_ie {
+	__u8 oui[3];
+	__u8 type;
+	struct ie_print print;
+	struct vendor_ie *next; /* internal */
+};
+
+void register_vendor_ie(struct vendor_ie *v);
+
+/* an element body inside the buffer of a struct ie_model */
+struct ie_ref {
+	__u16 off;
+	__u8 len;
+	bool present;
+};
+
+/*
+ * RSN/WPA element contents; cipher and AKM suites from the element's
+ * own OUI are kept as BIT(suite type), others set IE_SUITE_OTHER.
+ */
+#define IE_SUITE_OTHER	BIT(31)
+
+struct ie_rsn_info {
+	bool present;
+	__u16 version;
+	__u32 group;
+	__u32 pairwise;
+	__u32 akm;
+	__u16 capa;
+};
+
+#define IE_MODEL_MAX_ELEMS	256
+
+/*
+ * Information elements parsed in a single pass, without copying any
+ * data: element bodies are referenced by offset into @buf, which must
+ * stay valid for as long as the model is used.
+ */
+struct ie_model {
+	const unsigned char *buf;
+	int len;
+
+	/* first occurrence of the elements we know about */
+	struct ie_ref ssid, rates, ext_rates, ds, country, rsn,
+		      ht_capa, ht_op, vht_capa, vht_op, mesh_id,
+		      wpa, wmm, wps, p2p;
+
+	/* decoded fields */
+	__u8 channel;		/* primary channel, 0 if not advertised */
+	__u16 width;		/* operating width in MHz, 0 if unknown */
+	__u8 vht_center1, vht_center2;
+	__u8 max_rate;		/* in 500 kbps, over both rate elements */
+	__u8 n_country_triplets;
+	struct ie_rsn_info rsn_info, wpa_info;
+
+	/* all elements in the order they appear */
+	int n_elems;
+	bool truncated;		/* more than IE_MODEL_MAX_ELEMS */
+	struct ie_elem {
+		__u16 off;	/* of the element header */
+		__u8 id, len;
+	} elems[IE_MODEL_MAX_ELEMS];
+};
+
+void parse_ies(struct ie_model *m, const unsigned char *ie, int ielen);
+void print_ie_model(const struct ie_model *m, bool unknown,
+		    enum print_ie_type ptype);
 void print_ies(unsigned char *ie, int ielen, bool unknown,
 	       enum print_ie_type ptype);
 
+enum iw_format {
+	IW_FORMAT_TEXT,
+	IW_FORMAT_JSON,
+	IW_FORMAT_CBOR,
+};
+
+extern enum iw_format iw_format;
+
+int parse_format(const char *name);
+void fmt_obj_begin(const char *key);
+void fmt_obj_end(void);
+void fmt_arr_begin(const char *key);
+void fmt_arr_end(void);
+void fmt_int(const char *key, long long val);
+void fmt_uint(const char *key, unsigned long long val);
+void fmt_bool(const char *key, bool val);
+void fmt_str(const char *key, const char *val);
+void fmt_strn(const char *key, const char *val, int len);
+void fmt_bytes(const char *key, const __u8 *val, int len);
+void fmt_ssid(const char *key, const __u8 *ssid, int len);
+void fmt_mac(const char *key, const unsigned char *addr);
+void fmt_finish(bool complete);
+
+struct bss_store {
+	int fd;
+	bool writable;
+	void *map;
+	size_t map_len;
+	/* BSSID -> slot of the BSS record, open addressing */
+	__u32 *index;
+	__u32 index_size, index_used;
+};
+
+struct bss_store_entry {
+	__u32 time;		/* seconds since the epoch */
+	const __u8 *bssid;
+	const __u8 *ssid;
+	__u8 ssid_len;
+	__u16 freq;
+	int signal;		/* dBm */
+};
+
+int bss_store_open(struct bss_store *st, const char *path, bool writable);
+void bss_store_close(struct bss_store *st);
+int bss_store_add(struct bss_store *st, const unsigned char *bssid,
+		  const __u8 *ssid, __u8 ssid_len,
+		  __u32 time, __u16 freq, int signal);
+/* sightings in [from, to], of one BSS or all of them if bssid is NULL */
+int bss_store_query(struct bss_store *st, const unsigned char *bssid,
+		    __u32 from, __u32 to,
+		    void (*cb)(const struct bss_store_entry *e, void *priv),
+		    void *priv);
+
+enum rate_width {
+	RATE_WIDTH_NONE,	/* no width flag: 20 MHz or less */
+	RATE_WIDTH_40,
+	RATE_WIDTH_80,
+	RATE_WIDTH_80P80,
+	RATE_WIDTH_160,
+};
+
+/* a decoded NL80211_STA_INFO_TX_BITRATE/RX_BITRATE */
+struct rate_info {
+	__u32 bitrate;		/* 100 kbit/s, 0 if not known */
+	int mcs;		/* HT MCS index, -1 if none */
+	int vht_mcs;		/* VHT MCS index, -1 if none */
+	int vht_nss;		/* 0 if not given */
+	enum rate_width width;
+	bool short_gi;
+};
+
+int sta_bytes(struct nlattr **sinfo, bool tx, __u64 *bytes);
+int parse_rate_info(struct nlattr *bitrate_attr, struct rate_info *ri);
+const char *rate_width_name(enum rate_width width);
+void format_rate_info(const struct rate_info *ri, char *buf, int buflen);
 void parse_bitrate(struct nlattr *bitrate_attr, char *buf, int buflen);
 void iw_hexdump(const char *prefix, const __u8 *data, size_t len);
 
@@ -38,7 +38,8 @@ static int link_bss_handler(struct nl_msg *msg, void *arg)
 		[NL80211_BSS_STATUS] = { .type = NLA_U32 },
 	};
 	struct link_result *result = arg;
-	char mac_addr[20], dev[20];
+	char mac_addr[20];
+	const char *dev;
 
 	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
 		  genlmsg_attrlen(gnlh, 0), NULL);
@@ -61,7 +62,7 @@ static int link_bss_handler(struct nl_msg *msg, void *arg)
 		return NL_SKIP;
 
 	mac_addr_n2a(mac_addr, nla_data(bss[NL80211_BSS_BSSID]));
-	if_indextoname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]), dev);
+	dev = iw_ifname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]));
 
 	switch (nla_get_u32(bss[NL80211_BSS_STATUS])) {
 	case NL80211_BSS_STATUS_ASSOCIATED:
@@ -116,10 +117,13 @@ static int print_link_sta(struct nl_msg *msg, void *arg)
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct nlattr *sinfo[NL80211_STA_INFO_MAX + 1];
 	struct nlattr *binfo[NL80211_STA_BSS_PARAM_MAX + 1];
+	__u64 bytes;
 	static struct nla_policy stats_policy[NL80211_STA_INFO_MAX + 1] = {
 		[NL80211_STA_INFO_INACTIVE_TIME] = { .type = NLA_U32 },
 		[NL80211_STA_INFO_RX_BYTES] = { .type = NLA_U32 },
 		[NL80211_STA_INFO_TX_BYTES] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_RX_BYTES64] = { .type = NLA_U64 },
+		[NL80211_STA_INFO_TX_BYTES64] = { .type = NLA_U64 },
 		[NL80211_STA_INFO_RX_PACKETS] = { .type = NLA_U32 },
 		[NL80211_STA_INFO_TX_PACKETS] = { .type = NLA_U32 },
 		[NL80211_STA_INFO_SIGNAL] = { .type = NLA_U8 },
@@ -150,13 +154,13 @@ static int print_link_sta(struct nl_msg *msg, void *arg)
 		return NL_SKIP;
 	}
 
-	if (sinfo[NL80211_STA_INFO_RX_BYTES] && sinfo[NL80211_STA_INFO_RX_PACKETS])
-		printf("\tRX: %u bytes (%u packets)\n",
-			nla_get_u32(sinfo[NL80211_STA_INFO_RX_BYTES]),
+	if (sta_bytes(sinfo, false, &bytes) && sinfo[NL80211_STA_INFO_RX_PACKETS])
+		printf("\tRX: %llu bytes (%u packets)\n",
+			(unsigned long long)bytes,
 			nla_get_u32(sinfo[NL80211_STA_INFO_RX_PACKETS]));
-	if (sinfo[NL80211_STA_INFO_TX_BYTES] && sinfo[NL80211_STA_INFO_TX_PACKETS])
-		printf("\tTX: %u bytes (%u packets)\n",
-			nla_get_u32(sinfo[NL80211_STA_INFO_TX_BYTES]),
+	if (sta_bytes(sinfo, true, &bytes) && sinfo[NL80211_STA_INFO_TX_PACKETS])
+		printf("\tTX: %llu bytes (%u packets)\n",
+			(unsigned long long)bytes,
 			nla_get_u32(sinfo[NL80211_STA_INFO_TX_PACKETS]));
 	if (sinfo[NL80211_STA_INFO_SIGNAL])
 		printf("\tsignal: %d dBm\n",
@@ -29,7 +29,8 @@ static int print_mpath_handler(struct nl_msg *msg, void *arg)
 	struct nlattr *tb[NL80211_ATTR_MAX + 1];
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct nlattr *pinfo[NL80211_MPATH_INFO_MAX + 1];
-	char dst[20], next_hop[20], dev[20];
+	char dst[20], next_hop[20];
+	const char *dev;
 	static struct nla_policy mpath_policy[NL80211_MPATH_INFO_MAX + 1] = {
 		[NL80211_MPATH_INFO_FRAME_QLEN] = { .type = NLA_U32 },
 		[NL80211_MPATH_INFO_SN] = { .type = NLA_U32 },
@@ -62,7 +63,7 @@ static int print_mpath_handler(struct nl_msg *msg, void *arg)
 
 	mac_addr_n2a(dst, nla_data(tb[NL80211_ATTR_MAC]));
 	mac_addr_n2a(next_hop, nla_data(tb[NL80211_ATTR_MPATH_NEXT_HOP]));
-	if_indextoname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]), dev);
+	dev = iw_ifname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]));
 	printf("%s %s %s", dst, next_hop, dev);
 	if (pinfo[NL80211_MPATH_INFO_SN])
 		printf("\t%u",
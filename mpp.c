@@ -17,7 +17,8 @@ static int print_mpp_handler(struct nl_msg *msg, void *arg)
 {
 	struct nlattr *tb[NL80211_ATTR_MAX + 1];
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
-	char dst[20], next_hop[20], dev[20];
+	char dst[20], next_hop[20];
+	const char *dev;
 
 	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
 		  genlmsg_attrlen(gnlh, 0), NULL);
@@ -30,7 +31,7 @@ static int print_mpp_handler(struct nl_msg *msg, void *arg)
 
 	mac_addr_n2a(dst, nla_data(tb[NL80211_ATTR_MAC]));
 	mac_addr_n2a(next_hop, nla_data(tb[NL80211_ATTR_MPATH_NEXT_HOP]));
-	if_indextoname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]), dev);
+	dev = iw_ifname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]));
 	printf("%s %s %s\n", dst, next_hop, dev);
 
 	return NL_SKIP;
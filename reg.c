@@ -113,6 +113,78 @@ COMMAND(reg, set, "<ISO/IEC 3166-1 alpha2>",
 	NL80211_CMD_REQ_SET_REG, 0, CIB_NONE, handle_reg_set,
 	"Notify the kernel about the current regulatory domain.");
 
+static void print_reg_fmt(struct nlattr **tb_msg,
+			  struct nla_policy *reg_rule_policy)
+{
+	static const struct {
+		__u32 flag;
+		const char *name;
+	} rule_flags[] = {
+		{ NL80211_RRF_NO_OFDM, "NO-OFDM" },
+		{ NL80211_RRF_NO_CCK, "NO-CCK" },
+		{ NL80211_RRF_NO_INDOOR, "NO-INDOOR" },
+		{ NL80211_RRF_NO_OUTDOOR, "NO-OUTDOOR" },
+		{ NL80211_RRF_DFS, "DFS" },
+		{ NL80211_RRF_PTP_ONLY, "PTP-ONLY" },
+		{ NL80211_RRF_AUTO_BW, "AUTO-BW" },
+		{ NL80211_RRF_GO_CONCURRENT, "GO-CONCURRENT" },
+		{ NL80211_RRF_NO_HT40MINUS, "NO-HT40MINUS" },
+		{ NL80211_RRF_NO_HT40PLUS, "NO-HT40PLUS" },
+		{ NL80211_RRF_NO_80MHZ, "NO-80MHZ" },
+		{ NL80211_RRF_NO_160MHZ, "NO-160MHZ" },
+		{ NL80211_RRF_NO_IR, "NO-IR" },
+		{ __NL80211_RRF_NO_IBSS, "NO-IBSS" },
+	};
+	enum nl80211_dfs_regions dfs_domain = NL80211_DFS_UNSET;
+	struct nlattr *nl_rule;
+	int rem_rule, i;
+
+	fmt_obj_begin(NULL);
+	if (tb_msg[NL80211_ATTR_WIPHY]) {
+		fmt_uint("phy", nla_get_u32(tb_msg[NL80211_ATTR_WIPHY]));
+		fmt_bool("self_managed",
+			 !!tb_msg[NL80211_ATTR_WIPHY_SELF_MANAGED_REG]);
+	}
+	fmt_strn("country", nla_data(tb_msg[NL80211_ATTR_REG_ALPHA2]), 2);
+	if (tb_msg[NL80211_ATTR_DFS_REGION])
+		dfs_domain = nla_get_u8(tb_msg[NL80211_ATTR_DFS_REGION]);
+	fmt_str("dfs_region", dfs_domain_name(dfs_domain));
+
+	fmt_arr_begin("rules");
+	nla_for_each_nested(nl_rule, tb_msg[NL80211_ATTR_REG_RULES], rem_rule) {
+		struct nlattr *tb_rule[NL80211_REG_RULE_ATTR_MAX + 1];
+		__u32 flags;
+
+		nla_parse(tb_rule, NL80211_REG_RULE_ATTR_MAX, nla_data(nl_rule),
+			  nla_len(nl_rule), reg_rule_policy);
+
+		flags = nla_get_u32(tb_rule[NL80211_ATTR_REG_RULE_FLAGS]);
+
+		fmt_obj_begin(NULL);
+		fmt_uint("start_khz",
+			 nla_get_u32(tb_rule[NL80211_ATTR_FREQ_RANGE_START]));
+		fmt_uint("end_khz",
+			 nla_get_u32(tb_rule[NL80211_ATTR_FREQ_RANGE_END]));
+		fmt_uint("max_bw_khz",
+			 nla_get_u32(tb_rule[NL80211_ATTR_FREQ_RANGE_MAX_BW]));
+		fmt_uint("max_ant_gain_mbi",
+			 nla_get_u32(tb_rule[NL80211_ATTR_POWER_RULE_MAX_ANT_GAIN]));
+		fmt_uint("max_eirp_mbm",
+			 nla_get_u32(tb_rule[NL80211_ATTR_POWER_RULE_MAX_EIRP]));
+		if ((flags & NL80211_RRF_DFS) && tb_rule[NL80211_ATTR_DFS_CAC_TIME])
+			fmt_uint("dfs_cac_ms",
+				 nla_get_u32(tb_rule[NL80211_ATTR_DFS_CAC_TIME]));
+		fmt_arr_begin("flags");
+		for (i = 0; i < ARRAY_SIZE(rule_flags); i++)
+			if (flags & rule_flags[i].flag)
+				fmt_str(NULL, rule_flags[i].name);
+		fmt_arr_end();
+		fmt_obj_end();
+	}
+	fmt_arr_end();
+	fmt_obj_end();
+}
+
 static int print_reg_handler(struct nl_msg *msg, void *arg)
 {
 #define PARSE_FLAG(nl_flag, string_value)  do { \
@@ -149,6 +221,11 @@ static int print_reg_handler(struct nl_msg *msg, void *arg)
 		return NL_SKIP;
 	}
 
+	if (iw_format != IW_FORMAT_TEXT) {
+		print_reg_fmt(tb_msg, reg_rule_policy);
+		return NL_SKIP;
+	}
+
 	if (tb_msg[NL80211_ATTR_WIPHY])
 		printf("phy#%d%s\n", nla_get_u32(tb_msg[NL80211_ATTR_WIPHY]),
 		       tb_msg[NL80211_ATTR_WIPHY_SELF_MANAGED_REG] ?
@@ -258,8 +335,10 @@ static int handle_reg_get(struct nl80211_state *state,
 	return err;
 }
 COMMAND(reg, get, NULL, NL80211_CMD_GET_REG, 0, CIB_NONE, handle_reg_get,
-	"Print out the kernel's current regulatory domain information.");
+	"Print out the kernel's current regulatory domain information.",
+	.formats = true);
 COMMAND(reg, get, NULL, NL80211_CMD_GET_REG, 0, CIB_PHY, handle_reg_get,
-	"Print out the devices' current regulatory domain information.");
+	"Print out the devices' current regulatory domain information.",
+	.formats = true);
 HIDDEN(reg, dump, NULL, NL80211_CMD_GET_REG, NLM_F_DUMP, CIB_NONE,
        handle_reg_dump);
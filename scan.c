@@ -3,6 +3,10 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <netlink/genl/genl.h>
 #include <netlink/genl/family.h>
@@ -49,10 +53,21 @@ static unsigned char ms_oui[3]		= { 0x00, 0x50, 0xf2 };
 static unsigned char ieee80211_oui[3]	= { 0x00, 0x0f, 0xac };
 static unsigned char wfa_oui[3]		= { 0x50, 0x6f, 0x9a };
 
+struct scan_filter {
+	const char *ssid;
+	bool have_bssid, have_signal;
+	unsigned char bssid[ETH_ALEN];
+	int min_signal;		/* mBm */
+	__u32 freq;
+	__u32 max_age;		/* ms */
+};
+
 struct scan_params {
 	bool unknown;
 	enum print_ie_type type;
 	bool show_both_ie_sets;
+	struct scan_filter filter;
+	const char *change;	/* tag for --diff output */
 };
 
 #define IEEE80211_COUNTRY_EXTENSION_ID 201
@@ -99,6 +114,17 @@ static int parse_random_mac_addr(struct nl_msg *msg, char *arg)
 	return -ENOBUFS;
 }
 
+/*
+ * Frequencies requested by the last scan trigger, so that the combined
+ * scan command can recognise the completion event of its own scan.
+ * No frequencies (or too many to remember) means any are accepted.
+ */
+#define SCAN_REQ_MAX_FREQS	256
+static struct {
+	int n_freqs;
+	__u32 freqs[SCAN_REQ_MAX_FREQS];
+} scan_req;
+
 static int handle_scan(struct nl80211_state *state,
 		       struct nl_cb *cb,
 		       struct nl_msg *msg,
@@ -123,6 +149,8 @@ static int handle_scan(struct nl80211_state *state,
 	unsigned char *ies = NULL, *meshid = NULL, *tmpies;
 	unsigned int flags = 0;
 
+	scan_req.n_freqs = 0;
+
 	ssids = nlmsg_alloc();
 	if (!ssids)
 		return -ENOMEM;
@@ -182,6 +210,11 @@ static int handle_scan(struct nl80211_state *state,
 				continue;
 			}
 			NLA_PUT_U32(freqs, i, freq);
+			if (scan_req.n_freqs >= 0 &&
+			    scan_req.n_freqs < SCAN_REQ_MAX_FREQS)
+				scan_req.freqs[scan_req.n_freqs++] = freq;
+			else
+				scan_req.n_freqs = -1;
 			break;
 		case IES:
 			ies = parse_hex(argv[i], &ies_len);
@@ -229,6 +262,8 @@ static int handle_scan(struct nl80211_state *state,
 
 	if (have_freqs)
 		nla_put_nested(msg, NL80211_ATTR_SCAN_FREQUENCIES, freqs);
+	if (scan_req.n_freqs < 0)
+		scan_req.n_freqs = 0;
 	if (flags)
 		NLA_PUT_U32(msg, NL80211_ATTR_SCAN_FLAGS, flags);
 
@@ -923,7 +958,7 @@ static void print_vht_capa(const uint8_t type, uint8_t len, const uint8_t *data)
 {
 	printf("\n");
 	print_vht_info(data[0] | (data[1] << 8) |
-		       (data[2] << 16) | (data[3] << 24),
+		       (data[2] << 16) | ((__u32)data[3] << 24),
 		       data + 4);
 }
 
@@ -1004,13 +1039,6 @@ static void print_mesh_conf(const uint8_t type, uint8_t len, const uint8_t *data
 		printf("\t\t\t Mesh Power Save Level\n");
 }
 
-struct ie_print {
-	const char *name;
-	void (*print)(const uint8_t type, uint8_t len, const uint8_t *data);
-	uint8_t minlen, maxlen;
-	uint8_t flags;
-};
-
 static void print_ie(const struct ie_print *p, const uint8_t type,
 		     uint8_t len, const uint8_t *data)
 {
@@ -1068,7 +1096,7 @@ static const struct ie_print ieprinters[] = {
 	[127] = { "Extended capabilities", print_capabilities, 0, 255, BIT(PRINT_SCAN), },
 	[107] = { "802.11u Interworking", print_interworking, 0, 255, BIT(PRINT_SCAN), },
 	[108] = { "802.11u Advertisement", print_11u_advert, 0, 255, BIT(PRINT_SCAN), },
-	[111] = { "802.11u Roaming Consortium", print_11u_rcon, 0, 255, BIT(PRINT_SCAN), },
+	[111] = { "802.11u Roaming Consortium", print_11u_rcon, 2, 255, BIT(PRINT_SCAN), },
 };
 
 static void print_wifi_wpa(const uint8_t type, uint8_t len, const uint8_t *data)
@@ -1168,7 +1196,7 @@ static void print_wifi_wps(const uint8_t type, uint8_t len, const uint8_t *data)
 	while (len >= 4) {
 		subtype = (data[0] << 8) + data[1];
 		sublen = (data[2] << 8) + data[3];
-		if (sublen > len)
+		if (sublen > len - 4)
 			break;
 
 		switch (subtype) {
@@ -1330,12 +1358,6 @@ static void print_wifi_wps(const uint8_t type, uint8_t len, const uint8_t *data)
 	}
 }
 
-static const struct ie_print wifiprinters[] = {
-	[1] = { "WPA", print_wifi_wpa, 2, 255, BIT(PRINT_SCAN), },
-	[2] = { "WMM", print_wifi_wmm, 1, 255, BIT(PRINT_SCAN), },
-	[4] = { "WPS", print_wifi_wps, 0, 255, BIT(PRINT_SCAN), },
-};
-
 static inline void print_p2p(const uint8_t type, uint8_t len, const uint8_t *data)
 {
 	bool first = true;
@@ -1384,7 +1406,7 @@ static inline void print_p2p(const uint8_t type, uint8_t len, const uint8_t *dat
 		case 0x12: /* invitation flags */
 		case 0xdd: /* vendor specific */
 		default: {
-			const __u8 *subdata = data + 4;
+			const __u8 *subdata = data + 3;
 			__u16 tmplen = sublen;
 
 			tab_on_first(&first);
@@ -1426,14 +1448,76 @@ static inline void print_hs20_ind(const uint8_t type, uint8_t len, const uint8_t
 		printf("\t\tUnexpected length: %i\n", len);
 }
 
-static const struct ie_print wfa_printers[] = {
-	[9] = { "P2P", print_p2p, 2, 255, BIT(PRINT_SCAN), },
-	[16] = { "HotSpot 2.0 Indication", print_hs20_ind, 1, 255, BIT(PRINT_SCAN), },
+static struct vendor_ie builtin_vendor_ies[] = {
+	{ { 0x00, 0x50, 0xf2 }, 1, { "WPA", print_wifi_wpa, 2, 255, BIT(PRINT_SCAN), }, },
+	{ { 0x00, 0x50, 0xf2 }, 2, { "WMM", print_wifi_wmm, 1, 255, BIT(PRINT_SCAN), }, },
+	{ { 0x00, 0x50, 0xf2 }, 4, { "WPS", print_wifi_wps, 0, 255, BIT(PRINT_SCAN), }, },
+	{ { 0x50, 0x6f, 0x9a }, 9, { "P2P", print_p2p, 2, 255, BIT(PRINT_SCAN), }, },
+	{ { 0x50, 0x6f, 0x9a }, 16, { "HotSpot 2.0 Indication", print_hs20_ind, 1, 255, BIT(PRINT_SCAN), }, },
 };
 
-static void print_vendor(unsigned char len, unsigned char *data,
+/*
+ * Vendor element printers, hashed on OUI and vendor type so that the
+ * lookup costs the same however many of them are known. Entries added
+ * later take precedence over earlier ones for the same OUI and type.
+ */
+#define VENDOR_IE_HASH_BITS	6
+
+static struct vendor_ie *vendor_ies[1 << VENDOR_IE_HASH_BITS];
+
+static unsigned int vendor_ie_hash(const unsigned char *oui, __u8 type)
+{
+	__u32 key = (__u32)oui[0] << 24 | oui[1] << 16 | oui[2] << 8 | type;
+
+	return (key * 2654435761U) >> (32 - VENDOR_IE_HASH_BITS);
+}
+
+static void __register_vendor_ie(struct vendor_ie *v)
+{
+	unsigned int h = vendor_ie_hash(v->oui, v->type);
+
+	v->next = vendor_ies[h];
+	vendor_ies[h] = v;
+}
+
+static void vendor_ies_init(void)
+{
+	static bool done;
+	unsigned int i;
+
+	if (done)
+		return;
+	done = true;
+
+	for (i = 0; i < ARRAY_SIZE(builtin_vendor_ies); i++)
+		__register_vendor_ie(&builtin_vendor_ies[i]);
+}
+
+void register_vendor_ie(struct vendor_ie *v)
+{
+	/* keep the built-in ones behind it */
+	vendor_ies_init();
+	__register_vendor_ie(v);
+}
+
+static const struct vendor_ie *find_vendor_ie(const unsigned char *oui,
+					      __u8 type)
+{
+	struct vendor_ie *v;
+
+	vendor_ies_init();
+
+	for (v = vendor_ies[vendor_ie_hash(oui, type)]; v; v = v->next)
+		if (v->type == type && memcmp(v->oui, oui, 3) == 0)
+			return v;
+
+	return NULL;
+}
+
+static void print_vendor(unsigned char len, const unsigned char *data,
 			 bool unknown, enum print_ie_type ptype)
 {
+	const struct vendor_ie *v;
 	int i;
 
 	if (len < 3) {
@@ -1444,15 +1528,18 @@ static void print_vendor(unsigned char len, unsigned char *data,
 		return;
 	}
 
-	if (len >= 4 && memcmp(data, ms_oui, 3) == 0) {
-		if (data[3] < ARRAY_SIZE(wifiprinters) &&
-		    wifiprinters[data[3]].name &&
-		    wifiprinters[data[3]].flags & BIT(ptype)) {
-			print_ie(&wifiprinters[data[3]], data[3], len - 4, data + 4);
+	if (len >= 4) {
+		v = find_vendor_ie(data, data[3]);
+		if (v && v->print.name && v->print.flags & BIT(ptype)) {
+			print_ie(&v->print, data[3], len - 4, data + 4);
 			return;
 		}
-		if (!unknown)
-			return;
+	}
+
+	if (!unknown)
+		return;
+
+	if (len >= 4 && memcmp(data, ms_oui, 3) == 0) {
 		printf("\tMS/WiFi %#.2x, data:", data[3]);
 		for(i = 0; i < len - 4; i++)
 			printf(" %.02x", data[i + 4]);
@@ -1461,14 +1548,6 @@ static void print_vendor(unsigned char len, unsigned char *data,
 	}
 
 	if (len >= 4 && memcmp(data, wfa_oui, 3) == 0) {
-		if (data[3] < ARRAY_SIZE(wfa_printers) &&
-		    wfa_printers[data[3]].name &&
-		    wfa_printers[data[3]].flags & BIT(ptype)) {
-			print_ie(&wfa_printers[data[3]], data[3], len - 4, data + 4);
-			return;
-		}
-		if (!unknown)
-			return;
 		printf("\tWFA %#.2x, data:", data[3]);
 		for(i = 0; i < len - 4; i++)
 			printf(" %.02x", data[i + 4]);
@@ -1476,9 +1555,6 @@ static void print_vendor(unsigned char len, unsigned char *data,
 		return;
 	}
 
-	if (!unknown)
-		return;
-
 	printf("\tVendor specific: OUI %.2x:%.2x:%.2x, data:",
 		data[0], data[1], data[2]);
 	for (i = 3; i < len; i++)
@@ -1486,29 +1562,268 @@ static void print_vendor(unsigned char len, unsigned char *data,
 	printf("\n");
 }
 
-void print_ies(unsigned char *ie, int ielen, bool unknown,
-	       enum print_ie_type ptype)
+static void ie_ref_set(struct ie_ref *ref, const struct ie_model *m,
+		       const unsigned char *data, __u8 len)
 {
-	while (ielen >= 2 && ielen >= ie[1]) {
-		if (ie[0] < ARRAY_SIZE(ieprinters) &&
-		    ieprinters[ie[0]].name &&
-		    ieprinters[ie[0]].flags & BIT(ptype)) {
-			print_ie(&ieprinters[ie[0]], ie[0], ie[1], ie + 2);
-		} else if (ie[0] == 221 /* vendor */) {
-			print_vendor(ie[1], ie + 2, unknown, ptype);
-		} else if (unknown) {
-			int i;
-
-			printf("\tUnknown IE (%d):", ie[0]);
-			for (i=0; i<ie[1]; i++)
-				printf(" %.2x", ie[2+i]);
-			printf("\n");
+	if (ref->present)
+		return;
+	ref->off = data - m->buf;
+	ref->len = len;
+	ref->present = true;
+}
+
+static __u32 ie_suite_bit(const unsigned char *oui, const uint8_t *suite)
+{
+	if (memcmp(suite, oui, 3) || suite[3] > 30)
+		return IE_SUITE_OTHER;
+	return BIT(suite[3]);
+}
+
+/* same layout and defaults as print_rsn_ie() */
+static void parse_rsn_info(struct ie_rsn_info *info, const unsigned char *oui,
+			   __u32 defcipher, __u32 defauth,
+			   const uint8_t *data, int len)
+{
+	int count, i;
+
+	if (len < 2)
+		return;
+
+	info->present = true;
+	info->version = data[0] | (data[1] << 8);
+	info->group = info->pairwise = defcipher;
+	info->akm = defauth;
+	data += 2;
+	len -= 2;
+
+	if (len < 4)
+		return;
+	info->group = ie_suite_bit(oui, data);
+	data += 4;
+	len -= 4;
+
+	if (len < 2)
+		return;
+	count = data[0] | (data[1] << 8);
+	if (2 + (count * 4) > len)
+		return;
+	info->pairwise = 0;
+	for (i = 0; i < count; i++)
+		info->pairwise |= ie_suite_bit(oui, data + 2 + (i * 4));
+	data += 2 + (count * 4);
+	len -= 2 + (count * 4);
+
+	if (len < 2)
+		return;
+	count = data[0] | (data[1] << 8);
+	if (2 + (count * 4) > len)
+		return;
+	info->akm = 0;
+	for (i = 0; i < count; i++)
+		info->akm |= ie_suite_bit(oui, data + 2 + (i * 4));
+	data += 2 + (count * 4);
+	len -= 2 + (count * 4);
+
+	if (len >= 2)
+		info->capa = data[0] | (data[1] << 8);
+}
+
+static void parse_ie_rates(struct ie_model *m, const struct ie_ref *ref)
+{
+	const unsigned char *data = m->buf + ref->off;
+	int i;
+
+	for (i = 0; i < ref->len; i++) {
+		__u8 r = data[i] & 0x7f;
+
+		/* skip the BSS membership selectors */
+		if (r < 126 && r > m->max_rate)
+			m->max_rate = r;
+	}
+}
+
+static void parse_ie_channel(struct ie_model *m)
+{
+	const unsigned char *data;
+
+	if (m->ds.present && m->ds.len >= 1)
+		m->channel = m->buf[m->ds.off];
+
+	if (m->ht_op.present && m->ht_op.len >= 2) {
+		data = m->buf + m->ht_op.off;
+		m->channel = data[0];
+		m->width = 20;
+		/* secondary channel above or below, and any width allowed */
+		if ((data[1] & 0x3) && (data[1] & 0x4))
+			m->width = 40;
+	}
+
+	if (m->width && m->vht_op.present && m->vht_op.len >= 3) {
+		data = m->buf + m->vht_op.off;
+		m->vht_center1 = data[1];
+		m->vht_center2 = data[2];
+		switch (data[0]) {
+		case 1:
+			/* 160 and 80+80 may also be signalled via segment 2 */
+			m->width = data[2] ? 160 : 80;
+			break;
+		case 2:
+		case 3:
+			m->width = 160;
+			break;
+		}
+	}
+}
+
+void parse_ies(struct ie_model *m, const unsigned char *ie, int ielen)
+{
+	const unsigned char *data;
+	__u8 len;
+
+	memset(m, 0, offsetof(struct ie_model, elems));
+	m->buf = ie;
+	m->len = ielen;
+
+	while (ielen >= 2 && ielen >= ie[1] + 2) {
+		data = ie + 2;
+		len = ie[1];
+
+		if (m->n_elems < IE_MODEL_MAX_ELEMS) {
+			m->elems[m->n_elems].off = ie - m->buf;
+			m->elems[m->n_elems].id = ie[0];
+			m->elems[m->n_elems].len = len;
+			m->n_elems++;
+		} else
+			m->truncated = true;
+
+		switch (ie[0]) {
+		case 0:
+			ie_ref_set(&m->ssid, m, data, len);
+			break;
+		case 1:
+			ie_ref_set(&m->rates, m, data, len);
+			break;
+		case 3:
+			ie_ref_set(&m->ds, m, data, len);
+			break;
+		case 7:
+			ie_ref_set(&m->country, m, data, len);
+			break;
+		case 45:
+			ie_ref_set(&m->ht_capa, m, data, len);
+			break;
+		case 48:
+			ie_ref_set(&m->rsn, m, data, len);
+			break;
+		case 50:
+			ie_ref_set(&m->ext_rates, m, data, len);
+			break;
+		case 61:
+			ie_ref_set(&m->ht_op, m, data, len);
+			break;
+		case 114:
+			ie_ref_set(&m->mesh_id, m, data, len);
+			break;
+		case 191:
+			ie_ref_set(&m->vht_capa, m, data, len);
+			break;
+		case 192:
+			ie_ref_set(&m->vht_op, m, data, len);
+			break;
+		case 221:
+			if (len < 4)
+				break;
+			/* vendor elements refer to the data after OUI/type */
+			if (memcmp(data, ms_oui, 3) == 0) {
+				if (data[3] == 1)
+					ie_ref_set(&m->wpa, m, data + 4, len - 4);
+				else if (data[3] == 2)
+					ie_ref_set(&m->wmm, m, data + 4, len - 4);
+				else if (data[3] == 4)
+					ie_ref_set(&m->wps, m, data + 4, len - 4);
+			} else if (memcmp(data, wfa_oui, 3) == 0) {
+				if (data[3] == 9)
+					ie_ref_set(&m->p2p, m, data + 4, len - 4);
+			}
+			break;
 		}
+
+		ielen -= len + 2;
+		ie += len + 2;
+	}
+
+	if (m->rsn.present)
+		parse_rsn_info(&m->rsn_info, ieee80211_oui,
+			       BIT(4) /* CCMP */, BIT(1) /* 802.1X */,
+			       m->buf + m->rsn.off, m->rsn.len);
+	if (m->wpa.present)
+		parse_rsn_info(&m->wpa_info, ms_oui,
+			       BIT(2) /* TKIP */, BIT(1) /* 802.1X */,
+			       m->buf + m->wpa.off, m->wpa.len);
+	if (m->rates.present)
+		parse_ie_rates(m, &m->rates);
+	if (m->ext_rates.present)
+		parse_ie_rates(m, &m->ext_rates);
+	if (m->country.present && m->country.len >= 3)
+		m->n_country_triplets = (m->country.len - 3) / 3;
+	parse_ie_channel(m);
+}
+
+static void print_one_ie(__u8 id, __u8 len, const unsigned char *data,
+			 bool unknown, enum print_ie_type ptype)
+{
+	if (id < ARRAY_SIZE(ieprinters) &&
+	    ieprinters[id].name &&
+	    ieprinters[id].flags & BIT(ptype)) {
+		print_ie(&ieprinters[id], id, len, data);
+	} else if (id == 221 /* vendor */) {
+		print_vendor(len, data, unknown, ptype);
+	} else if (unknown) {
+		int i;
+
+		printf("\tUnknown IE (%d):", id);
+		for (i=0; i<len; i++)
+			printf(" %.2x", data[i]);
+		printf("\n");
+	}
+}
+
+void print_ie_model(const struct ie_model *m, bool unknown,
+		    enum print_ie_type ptype)
+{
+	const struct ie_elem *elem;
+	const unsigned char *ie;
+	int i, ielen;
+
+	for (i = 0; i < m->n_elems; i++) {
+		elem = &m->elems[i];
+		print_one_ie(elem->id, elem->len, m->buf + elem->off + 2,
+			     unknown, ptype);
+	}
+
+	if (!m->truncated)
+		return;
+
+	/* the index is full, walk the rest of the buffer directly */
+	elem = &m->elems[m->n_elems - 1];
+	ie = m->buf + elem->off + elem->len + 2;
+	ielen = m->len - (ie - m->buf);
+	while (ielen >= 2 && ielen >= ie[1] + 2) {
+		print_one_ie(ie[0], ie[1], ie + 2, unknown, ptype);
 		ielen -= ie[1] + 2;
 		ie += ie[1] + 2;
 	}
 }
 
+void print_ies(unsigned char *ie, int ielen, bool unknown,
+	       enum print_ie_type ptype)
+{
+	struct ie_model m;
+
+	parse_ies(&m, ie, ielen);
+	print_ie_model(&m, unknown, ptype);
+}
+
 static void print_capa_dmg(__u16 capa)
 {
 	switch (capa & WLAN_CAPABILITY_DMG_TYPE_MASK) {
@@ -1573,31 +1888,151 @@ static void print_capa_non_dmg(__u16 capa)
 		printf(" ImmediateBACK");
 }
 
-static int print_bss_handler(struct nl_msg *msg, void *arg)
+static void print_bss_fmt(struct nlattr **tb, struct nlattr **bss,
+			  const char *change)
+{
+	struct nlattr *ies = bss[NL80211_BSS_INFORMATION_ELEMENTS];
+	struct ie_model m;
+
+	fmt_obj_begin(NULL);
+	fmt_mac("bssid", nla_data(bss[NL80211_BSS_BSSID]));
+	if (change)
+		fmt_str("change", change);
+	if (tb[NL80211_ATTR_IFINDEX])
+		fmt_str("ifname",
+			iw_ifname(nla_get_u32(tb[NL80211_ATTR_IFINDEX])));
+
+	if (bss[NL80211_BSS_STATUS]) {
+		switch (nla_get_u32(bss[NL80211_BSS_STATUS])) {
+		case NL80211_BSS_STATUS_AUTHENTICATED:
+			fmt_str("status", "authenticated");
+			break;
+		case NL80211_BSS_STATUS_ASSOCIATED:
+			fmt_str("status", "associated");
+			break;
+		case NL80211_BSS_STATUS_IBSS_JOINED:
+			fmt_str("status", "joined");
+			break;
+		default:
+			fmt_uint("status", nla_get_u32(bss[NL80211_BSS_STATUS]));
+			break;
+		}
+	}
+	if (bss[NL80211_BSS_TSF])
+		fmt_uint("tsf", nla_get_u64(bss[NL80211_BSS_TSF]));
+	if (bss[NL80211_BSS_FREQUENCY])
+		fmt_uint("freq", nla_get_u32(bss[NL80211_BSS_FREQUENCY]));
+	if (bss[NL80211_BSS_BEACON_INTERVAL])
+		fmt_uint("beacon_interval",
+			 nla_get_u16(bss[NL80211_BSS_BEACON_INTERVAL]));
+	if (bss[NL80211_BSS_CAPABILITY])
+		fmt_uint("capability", nla_get_u16(bss[NL80211_BSS_CAPABILITY]));
+	if (bss[NL80211_BSS_SIGNAL_MBM])
+		fmt_int("signal_mbm",
+			(int)nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM]));
+	if (bss[NL80211_BSS_SIGNAL_UNSPEC])
+		fmt_uint("signal_unspec",
+			 nla_get_u8(bss[NL80211_BSS_SIGNAL_UNSPEC]));
+	if (bss[NL80211_BSS_SEEN_MS_AGO])
+		fmt_uint("seen_ms_ago", nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]));
+
+	if (!ies)
+		ies = bss[NL80211_BSS_BEACON_IES];
+	if (ies) {
+		parse_ies(&m, nla_data(ies), nla_len(ies));
+		if (m.ssid.present)
+			fmt_ssid("ssid", m.buf + m.ssid.off, m.ssid.len);
+		if (m.channel)
+			fmt_uint("channel", m.channel);
+		if (m.width)
+			fmt_uint("width", m.width);
+		if (m.max_rate)
+			fmt_uint("max_rate_kbps", m.max_rate * 500);
+		if (m.rsn_info.present) {
+			fmt_uint("rsn_pairwise", m.rsn_info.pairwise);
+			fmt_uint("rsn_akm", m.rsn_info.akm);
+		}
+		if (m.wpa_info.present) {
+			fmt_uint("wpa_pairwise", m.wpa_info.pairwise);
+			fmt_uint("wpa_akm", m.wpa_info.akm);
+		}
+	}
+	fmt_obj_end();
+}
+
+static bool bss_ssid_matches(struct nlattr *attr, const char *ssid)
+{
+	const unsigned char *ie = nla_data(attr);
+	int ielen = nla_len(attr);
+
+	/* only look for the SSID, there's no point decoding anything else */
+	while (ielen >= 2 && ielen >= ie[1] + 2) {
+		if (ie[0] == 0)
+			return ie[1] == strlen(ssid) &&
+			       memcmp(ie + 2, ssid, ie[1]) == 0;
+		ielen -= ie[1] + 2;
+		ie += ie[1] + 2;
+	}
+	return false;
+}
+
+/* check the raw attributes, so that filtered entries cost next to nothing */
+static bool bss_filtered(const struct scan_filter *f, struct nlattr **bss)
+{
+	struct nlattr *ies;
+
+	if (f->have_bssid &&
+	    memcmp(nla_data(bss[NL80211_BSS_BSSID]), f->bssid, ETH_ALEN))
+		return true;
+
+	if (f->freq && (!bss[NL80211_BSS_FREQUENCY] ||
+			nla_get_u32(bss[NL80211_BSS_FREQUENCY]) != f->freq))
+		return true;
+
+	if (f->have_signal && (!bss[NL80211_BSS_SIGNAL_MBM] ||
+			       (int)nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM]) <
+					f->min_signal))
+		return true;
+
+	if (f->max_age && bss[NL80211_BSS_SEEN_MS_AGO] &&
+	    nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]) > f->max_age)
+		return true;
+
+	if (f->ssid) {
+		ies = bss[NL80211_BSS_INFORMATION_ELEMENTS];
+		if (!ies)
+			ies = bss[NL80211_BSS_BEACON_IES];
+		if (!ies || !bss_ssid_matches(ies, f->ssid))
+			return true;
+	}
+
+	return false;
+}
+
+static struct nla_policy bss_policy[NL80211_BSS_MAX + 1] = {
+	[NL80211_BSS_TSF] = { .type = NLA_U64 },
+	[NL80211_BSS_FREQUENCY] = { .type = NLA_U32 },
+	[NL80211_BSS_BSSID] = { },
+	[NL80211_BSS_BEACON_INTERVAL] = { .type = NLA_U16 },
+	[NL80211_BSS_CAPABILITY] = { .type = NLA_U16 },
+	[NL80211_BSS_INFORMATION_ELEMENTS] = { },
+	[NL80211_BSS_SIGNAL_MBM] = { .type = NLA_U32 },
+	[NL80211_BSS_SIGNAL_UNSPEC] = { .type = NLA_U8 },
+	[NL80211_BSS_STATUS] = { .type = NLA_U32 },
+	[NL80211_BSS_SEEN_MS_AGO] = { .type = NLA_U32 },
+	[NL80211_BSS_BEACON_IES] = { },
+};
+
+/* print one BSS from the attributes of a scan dump message */
+static int print_bss(struct nlattr *attrs, int len, struct scan_params *params)
 {
 	struct nlattr *tb[NL80211_ATTR_MAX + 1];
-	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct nlattr *bss[NL80211_BSS_MAX + 1];
-	char mac_addr[20], dev[20];
-	static struct nla_policy bss_policy[NL80211_BSS_MAX + 1] = {
-		[NL80211_BSS_TSF] = { .type = NLA_U64 },
-		[NL80211_BSS_FREQUENCY] = { .type = NLA_U32 },
-		[NL80211_BSS_BSSID] = { },
-		[NL80211_BSS_BEACON_INTERVAL] = { .type = NLA_U16 },
-		[NL80211_BSS_CAPABILITY] = { .type = NLA_U16 },
-		[NL80211_BSS_INFORMATION_ELEMENTS] = { },
-		[NL80211_BSS_SIGNAL_MBM] = { .type = NLA_U32 },
-		[NL80211_BSS_SIGNAL_UNSPEC] = { .type = NLA_U8 },
-		[NL80211_BSS_STATUS] = { .type = NLA_U32 },
-		[NL80211_BSS_SEEN_MS_AGO] = { .type = NLA_U32 },
-		[NL80211_BSS_BEACON_IES] = { },
-	};
-	struct scan_params *params = arg;
+	char mac_addr[20];
 	int show = params->show_both_ie_sets ? 2 : 1;
 	bool is_dmg = false;
 
-	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
-		  genlmsg_attrlen(gnlh, 0), NULL);
+	nla_parse(tb, NL80211_ATTR_MAX, attrs, len, NULL);
 
 	if (!tb[NL80211_ATTR_BSS]) {
 		fprintf(stderr, "bss info missing!\n");
@@ -1613,11 +2048,19 @@ static int print_bss_handler(struct nl_msg *msg, void *arg)
 	if (!bss[NL80211_BSS_BSSID])
 		return NL_SKIP;
 
+	if (bss_filtered(&params->filter, bss))
+		return NL_SKIP;
+
+	if (iw_format != IW_FORMAT_TEXT) {
+		print_bss_fmt(tb, bss, params->change);
+		return NL_SKIP;
+	}
+
 	mac_addr_n2a(mac_addr, nla_data(bss[NL80211_BSS_BSSID]));
 	printf("BSS %s", mac_addr);
 	if (tb[NL80211_ATTR_IFINDEX]) {
-		if_indextoname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]), dev);
-		printf("(on %s)", dev);
+		printf("(on %s)",
+		       iw_ifname(nla_get_u32(tb[NL80211_ATTR_IFINDEX])));
 	}
 
 	if (bss[NL80211_BSS_STATUS]) {
@@ -1637,6 +2080,8 @@ static int print_bss_handler(struct nl_msg *msg, void *arg)
 			break;
 		}
 	}
+	if (params->change)
+		printf(" [%s]", params->change);
 	printf("\n");
 
 	if (bss[NL80211_BSS_TSF]) {
@@ -1695,118 +2140,2469 @@ static int print_bss_handler(struct nl_msg *msg, void *arg)
 	return NL_SKIP;
 }
 
+static int print_bss_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+
+	return print_bss(genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0),
+			 arg);
+}
+
 static struct scan_params scan_params;
 
-static int handle_scan_dump(struct nl80211_state *state,
-			    struct nl_cb *cb,
-			    struct nl_msg *msg,
-			    int argc, char **argv,
-			    enum id_input id)
+enum scan_sort {
+	SCAN_SORT_NONE,
+	SCAN_SORT_SIGNAL,
+	SCAN_SORT_AGE,
+	SCAN_SORT_FREQ,
+};
+
+struct bss_record {
+	long long key;		/* larger sorts first */
+	int len;
+	void *attrs;		/* copy of the message attributes */
+};
+
+/*
+ * Sorted output: a min-heap on the sort key holds the best records seen
+ * so far. With --top it never grows beyond N entries, the weakest one is
+ * at the root and is the one replaced by anything better.
+ */
+static struct {
+	enum scan_sort sort;
+	int top;		/* 0 for no limit */
+	int n_records, size;
+	struct bss_record *heap;
+} scan_sorted;
+
+static void bss_heap_down(struct bss_record *heap, int n, int i)
 {
-	if (argc > 1)
-		return 1;
+	struct bss_record tmp;
+	int child;
 
-	memset(&scan_params, 0, sizeof(scan_params));
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n && heap[child + 1].key < heap[child].key)
+			child++;
+		if (heap[i].key <= heap[child].key)
+			break;
+		tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+		i = child;
+	}
+}
 
-	if (argc == 1 && !strcmp(argv[0], "-u"))
-		scan_params.unknown = true;
-	else if (argc == 1 && !strcmp(argv[0], "-b"))
-		scan_params.show_both_ie_sets = true;
+static void bss_heap_up(struct bss_record *heap, int i)
+{
+	struct bss_record tmp;
+	int parent;
+
+	while (i && heap[parent = (i - 1) / 2].key > heap[i].key) {
+		tmp = heap[i];
+		heap[i] = heap[parent];
+		heap[parent] = tmp;
+		i = parent;
+	}
+}
 
-	scan_params.type = PRINT_SCAN;
+static long long bss_sort_key(struct nlattr **bss)
+{
+	switch (scan_sorted.sort) {
+	case SCAN_SORT_SIGNAL:
+		if (bss[NL80211_BSS_SIGNAL_MBM])
+			return (int)nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM]);
+		/* the unitless quality sorts below any dBm value */
+		if (bss[NL80211_BSS_SIGNAL_UNSPEC])
+			return nla_get_u8(bss[NL80211_BSS_SIGNAL_UNSPEC]) - 100000;
+		break;
+	case SCAN_SORT_AGE:
+		if (bss[NL80211_BSS_SEEN_MS_AGO])
+			return -(long long)nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]);
+		break;
+	case SCAN_SORT_FREQ:
+		if (bss[NL80211_BSS_FREQUENCY])
+			return -(long long)nla_get_u32(bss[NL80211_BSS_FREQUENCY]);
+		break;
+	case SCAN_SORT_NONE:
+		return 0;
+	}
 
-	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, print_bss_handler,
-		  &scan_params);
-	return 0;
+	/* entries without the value go last */
+	return LLONG_MIN;
 }
 
-static int handle_scan_combined(struct nl80211_state *state,
-				struct nl_cb *cb,
-				struct nl_msg *msg,
-				int argc, char **argv,
-				enum id_input id)
+static int collect_bss_handler(struct nl_msg *msg, void *arg)
 {
-	char **trig_argv;
-	static char *dump_argv[] = {
-		NULL,
-		"scan",
-		"dump",
-		NULL,
-	};
-	static const __u32 cmds[] = {
-		NL80211_CMD_NEW_SCAN_RESULTS,
-		NL80211_CMD_SCAN_ABORTED,
-	};
-	int trig_argc, dump_argc, err;
+	struct scan_params *params = arg;
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *bss[NL80211_BSS_MAX + 1];
+	struct bss_record rec, *heap;
+	int size;
 
-	if (argc >= 3 && !strcmp(argv[2], "-u")) {
-		dump_argc = 4;
-		dump_argv[3] = "-u";
-	} else if (argc >= 3 && !strcmp(argv[2], "-b")) {
-		dump_argc = 4;
-		dump_argv[3] = "-b";
-	} else
-		dump_argc = 3;
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
 
-	trig_argc = 3 + (argc - 2) + (3 - dump_argc);
-	trig_argv = calloc(trig_argc, sizeof(*trig_argv));
-	if (!trig_argv)
-		return -ENOMEM;
-	trig_argv[0] = argv[0];
-	trig_argv[1] = "scan";
-	trig_argv[2] = "trigger";
+	if (!tb[NL80211_ATTR_BSS] ||
+	    nla_parse_nested(bss, NL80211_BSS_MAX, tb[NL80211_ATTR_BSS],
+			     bss_policy) ||
+	    !bss[NL80211_BSS_BSSID])
+		return NL_SKIP;
+
+	if (bss_filtered(&params->filter, bss))
+		return NL_SKIP;
+
+	rec.key = bss_sort_key(bss);
+	if (scan_sorted.top && scan_sorted.n_records == scan_sorted.top &&
+	    rec.key <= scan_sorted.heap[0].key)
+		return NL_SKIP;
+
+	rec.len = genlmsg_attrlen(gnlh, 0);
+	rec.attrs = malloc(rec.len);
+	if (!rec.attrs)
+		return NL_SKIP;
+	memcpy(rec.attrs, genlmsg_attrdata(gnlh, 0), rec.len);
+
+	if (scan_sorted.top && scan_sorted.n_records == scan_sorted.top) {
+		free(scan_sorted.heap[0].attrs);
+		scan_sorted.heap[0] = rec;
+		bss_heap_down(scan_sorted.heap, scan_sorted.n_records, 0);
+		return NL_SKIP;
+	}
+
+	if (scan_sorted.n_records == scan_sorted.size) {
+		if (scan_sorted.top)
+			size = scan_sorted.top;
+		else
+			size = scan_sorted.size ? 2 * scan_sorted.size : 32;
+		heap = realloc(scan_sorted.heap, size * sizeof(*heap));
+		if (!heap) {
+			free(rec.attrs);
+			return NL_SKIP;
+		}
+		scan_sorted.heap = heap;
+		scan_sorted.size = size;
+	}
+
+	scan_sorted.heap[scan_sorted.n_records] = rec;
+	bss_heap_up(scan_sorted.heap, scan_sorted.n_records++);
+
+	return NL_SKIP;
+}
+
+#define SCAN_DIFF_MAGIC		0x49575332	/* "IWS2" */
+#define SCAN_DIFF_SIGNAL_STEP	5		/* dB */
+
+/* what --diff remembers about a BSS between runs */
+struct bss_state {
+	__u8 bssid[ETH_ALEN];
+	__s8 signal;		/* dBm, rounded down to SIGNAL_STEP */
+	__u8 seen;		/* only used while comparing */
+	__u16 capability;
+	__u32 freq;
+	__u32 ie_hash;
+};
+
+static struct {
+	const char *path;
+	__u32 filter;		/* hash of the filter arguments */
+	struct bss_state *old, *new;
+	int n_old, n_new, size;
+} scan_diff;
+
+static int bss_state_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, ETH_ALEN);
+}
+
+/*
+ * FNV-1a over the IEs, leaving out the TIM and BSS Load elements as
+ * they change from beacon to beacon without anything of interest
+ * happening.
+ */
+static __u32 bss_ie_hash(struct nlattr *attr)
+{
+	const unsigned char *ie = nla_data(attr);
+	int ielen = nla_len(attr), i;
+	__u32 hash = 2166136261u;
+
+	while (ielen >= 2 && ielen >= ie[1] + 2) {
+		if (ie[0] != 5 && ie[0] != 11) {
+			for (i = 0; i < ie[1] + 2; i++) {
+				hash ^= ie[i];
+				hash *= 16777619;
+			}
+		}
+		ielen -= ie[1] + 2;
+		ie += ie[1] + 2;
+	}
+
+	return hash;
+}
+
+static void bss_state_fill(struct bss_state *st, struct nlattr **bss)
+{
+	struct nlattr *ies = bss[NL80211_BSS_INFORMATION_ELEMENTS];
+	int s;
+
+	memset(st, 0, sizeof(*st));
+	memcpy(st->bssid, nla_data(bss[NL80211_BSS_BSSID]), ETH_ALEN);
+	if (bss[NL80211_BSS_SIGNAL_MBM]) {
+		s = (int)nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM]) / 100;
+		/* round towards minus infinity for negative values too */
+		s -= ((s % SCAN_DIFF_SIGNAL_STEP) + SCAN_DIFF_SIGNAL_STEP) %
+		     SCAN_DIFF_SIGNAL_STEP;
+		st->signal = s < -128 ? -128 : s;
+	}
+	if (bss[NL80211_BSS_CAPABILITY])
+		st->capability = nla_get_u16(bss[NL80211_BSS_CAPABILITY]);
+	if (bss[NL80211_BSS_FREQUENCY])
+		st->freq = nla_get_u32(bss[NL80211_BSS_FREQUENCY]);
+	if (!ies)
+		ies = bss[NL80211_BSS_BEACON_IES];
+	if (ies)
+		st->ie_hash = bss_ie_hash(ies);
+}
+
+/*
+ * The file is a header of the magic, the filter hash and the number of
+ * records, and the records sorted by BSSID. A state saved with other
+ * filters can't be compared against: what it doesn't have may just not
+ * have passed the filters then, what it has may not pass them now.
+ */
+static int scan_diff_load(const char *path)
+{
+	__u32 hdr[3];
+	struct stat sb;
+	FILE *f;
+	int err = 0;
+
+	f = fopen(path, "r");
+	if (!f)
+		/* first run, everything is new */
+		return errno == ENOENT ? 0 : -errno;
+
+	if (fstat(fileno(f), &sb)) {
+		err = -errno;
+		goto out;
+	}
+
+	if (fread(hdr, sizeof(hdr), 1, f) != 1 || hdr[0] != SCAN_DIFF_MAGIC ||
+	    (unsigned long long)sb.st_size !=
+	    sizeof(hdr) + (unsigned long long)hdr[2] * sizeof(struct bss_state)) {
+		fprintf(stderr, "%s: not a scan state file\n", path);
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (hdr[1] != scan_diff.filter) {
+		fprintf(stderr, "%s: saved with other filters, starting over\n",
+			path);
+		goto out;
+	}
+
+	scan_diff.old = calloc(hdr[2] + 1, sizeof(*scan_diff.old));
+	if (!scan_diff.old) {
+		err = -ENOMEM;
+		goto out;
+	}
+	if (fread(scan_diff.old, sizeof(*scan_diff.old), hdr[2], f) != hdr[2]) {
+		fprintf(stderr, "%s: truncated scan state file\n", path);
+		err = -EINVAL;
+		goto out;
+	}
+	scan_diff.n_old = hdr[2];
+ out:
+	fclose(f);
+	return err;
+}
+
+/* written to a temporary file first so a crash never leaves half a state */
+static int scan_diff_save(const char *path)
+{
+	__u32 hdr[3] = { SCAN_DIFF_MAGIC, scan_diff.filter, scan_diff.n_new };
+	int len = strlen(path) + 5;
+	char *tmp;
+	FILE *f;
+	int err = 0;
+
+	tmp = malloc(len);
+	if (!tmp)
+		return -ENOMEM;
+	snprintf(tmp, len, "%s.tmp", path);
+
+	f = fopen(tmp, "w");
+	if (!f) {
+		err = -errno;
+		goto out;
+	}
+
+	qsort(scan_diff.new, scan_diff.n_new, sizeof(*scan_diff.new),
+	      bss_state_cmp);
+	if (fwrite(hdr, sizeof(hdr), 1, f) != 1 ||
+	    fwrite(scan_diff.new, sizeof(*scan_diff.new), scan_diff.n_new,
+		   f) != scan_diff.n_new)
+		err = -EIO;
+	if (fclose(f) && !err)
+		err = -errno;
+	if (!err && rename(tmp, path))
+		err = -errno;
+	if (err)
+		unlink(tmp);
+ out:
+	free(tmp);
+	return err;
+}
+
+static int print_bss(struct nlattr *attrs, int len, struct scan_params *params);
+
+static int diff_bss_handler(struct nl_msg *msg, void *arg)
+{
+	struct scan_params *params = arg;
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *bss[NL80211_BSS_MAX + 1];
+	struct bss_state *st, *old;
+	int size;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_BSS] ||
+	    nla_parse_nested(bss, NL80211_BSS_MAX, tb[NL80211_ATTR_BSS],
+			     bss_policy) ||
+	    !bss[NL80211_BSS_BSSID])
+		return NL_SKIP;
+
+	if (bss_filtered(&params->filter, bss))
+		return NL_SKIP;
+
+	if (scan_diff.n_new == scan_diff.size) {
+		size = scan_diff.size ? 2 * scan_diff.size : 64;
+		st = realloc(scan_diff.new, size * sizeof(*st));
+		if (!st)
+			return NL_SKIP;
+		scan_diff.new = st;
+		scan_diff.size = size;
+	}
+
+	st = &scan_diff.new[scan_diff.n_new++];
+	bss_state_fill(st, bss);
+
+	old = bsearch(st, scan_diff.old, scan_diff.n_old, sizeof(*old),
+		      bss_state_cmp);
+	if (!old)
+		params->change = "new";
+	else if (old->seen++)
+		/* the same BSSID again, e.g. on another interface */
+		params->change = NULL;
+	else if (old->signal != st->signal || old->freq != st->freq ||
+		 old->capability != st->capability ||
+		 old->ie_hash != st->ie_hash)
+		params->change = "changed";
+	else
+		params->change = NULL;
+
+	if (params->change)
+		print_bss(genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0),
+			  params);
+	params->change = NULL;
+
+	return NL_SKIP;
+}
+
+static void scan_diff_print_vanished(void)
+{
+	char mac_addr[20];
+	int i;
+
+	for (i = 0; i < scan_diff.n_old; i++) {
+		if (scan_diff.old[i].seen)
+			continue;
+		if (iw_format != IW_FORMAT_TEXT) {
+			fmt_obj_begin(NULL);
+			fmt_mac("bssid", scan_diff.old[i].bssid);
+			fmt_str("change", "vanished");
+			fmt_obj_end();
+			continue;
+		}
+		mac_addr_n2a(mac_addr, scan_diff.old[i].bssid);
+		printf("BSS %s [vanished]\n", mac_addr);
+	}
+}
+
+/* the BSS store "scan dump --store" records into, while it's open */
+static struct {
+	bool open;
+	struct bss_store st;
+	int (*next)(struct nl_msg *msg, void *arg);
+} scan_store;
+
+static int store_bss_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *bss[NL80211_BSS_MAX + 1];
+	struct nlattr *ies;
+	struct ie_model m;
+	unsigned int age = 0;
+	int signal = 0, err;
+	__u16 freq = 0;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_BSS] ||
+	    nla_parse_nested(bss, NL80211_BSS_MAX, tb[NL80211_ATTR_BSS],
+			     bss_policy) ||
+	    !bss[NL80211_BSS_BSSID])
+		goto out;
+
+	ies = bss[NL80211_BSS_INFORMATION_ELEMENTS];
+	if (!ies)
+		ies = bss[NL80211_BSS_BEACON_IES];
+	if (ies)
+		parse_ies(&m, nla_data(ies), nla_len(ies));
+	else
+		parse_ies(&m, NULL, 0);
+
+	if (bss[NL80211_BSS_FREQUENCY])
+		freq = nla_get_u32(bss[NL80211_BSS_FREQUENCY]);
+	if (bss[NL80211_BSS_SIGNAL_MBM])
+		signal = (int)nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM]) / 100;
+	if (bss[NL80211_BSS_SEEN_MS_AGO])
+		age = nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]);
+
+	err = bss_store_add(&scan_store.st, nla_data(bss[NL80211_BSS_BSSID]),
+			    m.ssid.present ? m.buf + m.ssid.off : NULL,
+			    m.ssid.present ? m.ssid.len : 0,
+			    time(NULL) - age / 1000, freq, signal);
+	if (err)
+		fprintf(stderr, "failed to store BSS: %d (%s)\n",
+			err, strerror(-err));
+ out:
+	return scan_store.next(msg, arg);
+}
+
+/* the filter options of the scan dump commands, 1 if they're wrong */
+static int parse_scan_filter(struct scan_filter *f, int argc, char **argv)
+{
+	char *end;
+
+	while (argc) {
+		if (argc < 2)
+			return 1;
+		if (!strcmp(argv[0], "--ssid")) {
+			f->ssid = argv[1];
+		} else if (!strcmp(argv[0], "--bssid")) {
+			if (mac_addr_a2n(f->bssid, argv[1]))
+				return 1;
+			f->have_bssid = true;
+		} else if (!strcmp(argv[0], "--min-signal")) {
+			f->min_signal = strtol(argv[1], &end, 10) * 100;
+			if (*end)
+				return 1;
+			f->have_signal = true;
+		} else if (!strcmp(argv[0], "--freq")) {
+			f->freq = strtoul(argv[1], &end, 10);
+			if (*end || !f->freq)
+				return 1;
+		} else if (!strcmp(argv[0], "--max-age")) {
+			f->max_age = strtoul(argv[1], &end, 10);
+			if (*end || !f->max_age)
+				return 1;
+		} else
+			return 1;
+		argc -= 2;
+		argv += 2;
+	}
+
+	return 0;
+}
+
+static int handle_scan_dump(struct nl80211_state *state,
+			    struct nl_cb *cb,
+			    struct nl_msg *msg,
+			    int argc, char **argv,
+			    enum id_input id)
+{
+	int (*handler)(struct nl_msg *msg, void *arg);
+
+	memset(&scan_params, 0, sizeof(scan_params));
+
+	if (argc && !strcmp(argv[0], "-u")) {
+		scan_params.unknown = true;
+		argc--;
+		argv++;
+	} else if (argc && !strcmp(argv[0], "-b")) {
+		scan_params.show_both_ie_sets = true;
+		argc--;
+		argv++;
+	}
+
+	if (parse_scan_filter(&scan_params.filter, argc, argv))
+		return 1;
+
+	scan_params.type = PRINT_SCAN;
+
+	if (scan_diff.path)
+		handler = diff_bss_handler;
+	else if (scan_sorted.sort)
+		handler = collect_bss_handler;
+	else
+		handler = print_bss_handler;
+
+	if (scan_store.open) {
+		scan_store.next = handler;
+		handler = store_bss_handler;
+	}
+
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, handler, &scan_params);
+	return 0;
+}
+
+static const struct cmd *scan_dump_cmd;
+static const struct cmd *scan_dump_sorted_cmd;
+static const struct cmd *scan_dump_diff_cmd;
+static const struct cmd *scan_dump_store_cmd;
+
+static const struct cmd *select_scan_dump_cmd(int argc, char **argv)
+{
+	int i;
+
+	/* --store goes first, the others are chosen again after it */
+	if (!scan_store.open)
+		for (i = 0; i < argc; i++)
+			if (!strcmp(argv[i], "--store"))
+				return scan_dump_store_cmd;
+	for (i = 0; i < argc; i++)
+		if (!strcmp(argv[i], "--diff"))
+			return scan_dump_diff_cmd;
+	for (i = 0; i < argc; i++)
+		if (!strcmp(argv[i], "--sort") || !strcmp(argv[i], "--top"))
+			return scan_dump_sorted_cmd;
+	return scan_dump_cmd;
+}
+
+static int handle_scan_dump_store(struct nl80211_state *state,
+				  struct nl_cb *cb,
+				  struct nl_msg *msg,
+				  int argc, char **argv,
+				  enum id_input id)
+{
+	const char *path = NULL;
+	char **dump_argv;
+	int dump_argc = 0, i, err = 0;
+
+	dump_argv = calloc(argc, sizeof(*dump_argv));
+	if (!dump_argv)
+		return -ENOMEM;
+
+	/* keep "wlan0 scan dump" and the other options, take out --store */
+	for (i = 0; i < argc; i++) {
+		if (i >= 3 && !strcmp(argv[i], "--store")) {
+			if (i + 1 == argc || path)
+				err = 1;
+			else
+				path = argv[++i];
+		} else
+			dump_argv[dump_argc++] = argv[i];
+	}
+
+	if (!err) {
+		err = bss_store_open(&scan_store.st, path, true);
+		if (err)
+			fprintf(stderr, "%s: %s\n", path, strerror(-err));
+	}
+	if (!err) {
+		scan_store.open = true;
+		err = handle_cmd(state, id, dump_argc, dump_argv);
+		bss_store_close(&scan_store.st);
+		scan_store.open = false;
+	}
+
+	free(dump_argv);
+	return err;
+}
+
+/* FNV-1a over the filter arguments, as "scan dump" parses them */
+static __u32 scan_diff_filter_hash(int argc, char **argv)
+{
+	__u32 hash = 2166136261u;
+	const char *c;
+	int i;
+
+	if (argc && (!strcmp(argv[0], "-u") || !strcmp(argv[0], "-b"))) {
+		argc--;
+		argv++;
+	}
+
+	for (i = 0; i < argc; i++) {
+		/* the terminating NUL keeps "a b" and "ab" apart */
+		for (c = argv[i]; ; c++) {
+			hash ^= (unsigned char)*c;
+			hash *= 16777619;
+			if (!*c)
+				break;
+		}
+	}
+
+	return hash;
+}
+
+static int handle_scan_dump_diff(struct nl80211_state *state,
+				 struct nl_cb *cb,
+				 struct nl_msg *msg,
+				 int argc, char **argv,
+				 enum id_input id)
+{
+	char **dump_argv;
+	int dump_argc = 0, i, err = 0;
+
+	dump_argv = calloc(argc, sizeof(*dump_argv));
+	if (!dump_argv)
+		return -ENOMEM;
+
+	/* keep "wlan0 scan dump" and the filters, take out --diff */
+	for (i = 0; i < argc; i++) {
+		if (i >= 3 && !strcmp(argv[i], "--diff")) {
+			if (i + 1 == argc || scan_diff.path)
+				err = 1;
+			else
+				scan_diff.path = argv[++i];
+		} else if (i >= 3 && (!strcmp(argv[i], "--sort") ||
+				      !strcmp(argv[i], "--top"))) {
+			err = 1;
+		} else
+			dump_argv[dump_argc++] = argv[i];
+	}
+
+	if (!err) {
+		scan_diff.filter = scan_diff_filter_hash(dump_argc - 3,
+							 dump_argv + 3);
+		err = scan_diff_load(scan_diff.path);
+	}
+	if (!err) {
+		qsort(scan_diff.old, scan_diff.n_old, sizeof(*scan_diff.old),
+		      bss_state_cmp);
+		err = handle_cmd(state, id, dump_argc, dump_argv);
+	}
+	if (!err) {
+		scan_diff_print_vanished();
+		err = scan_diff_save(scan_diff.path);
+		if (err)
+			fprintf(stderr, "failed to write %s\n", scan_diff.path);
+	}
+
+	free(dump_argv);
+	free(scan_diff.old);
+	free(scan_diff.new);
+	memset(&scan_diff, 0, sizeof(scan_diff));
+	return err;
+}
+
+static int handle_scan_dump_sorted(struct nl80211_state *state,
+				   struct nl_cb *cb,
+				   struct nl_msg *msg,
+				   int argc, char **argv,
+				   enum id_input id)
+{
+	struct bss_record tmp;
+	char **dump_argv, *end;
+	int dump_argc = 0, i, n, err = 0;
+
+	scan_sorted.sort = SCAN_SORT_SIGNAL;
+	scan_sorted.top = 0;
+
+	dump_argv = calloc(argc, sizeof(*dump_argv));
+	if (!dump_argv)
+		return -ENOMEM;
+
+	/* keep "wlan0 scan dump" and the filters, take out our options */
+	for (i = 0; i < argc; i++) {
+		if (i >= 3 && i + 1 < argc && !strcmp(argv[i], "--sort")) {
+			i++;
+			if (!strcmp(argv[i], "signal"))
+				scan_sorted.sort = SCAN_SORT_SIGNAL;
+			else if (!strcmp(argv[i], "age"))
+				scan_sorted.sort = SCAN_SORT_AGE;
+			else if (!strcmp(argv[i], "freq"))
+				scan_sorted.sort = SCAN_SORT_FREQ;
+			else
+				err = 1;
+		} else if (i >= 3 && i + 1 < argc && !strcmp(argv[i], "--top")) {
+			i++;
+			scan_sorted.top = strtoul(argv[i], &end, 10);
+			if (*end || scan_sorted.top <= 0)
+				err = 1;
+		} else if (i >= 3 && (!strcmp(argv[i], "--sort") ||
+				      !strcmp(argv[i], "--top"))) {
+			err = 1;
+		} else
+			dump_argv[dump_argc++] = argv[i];
+	}
+
+	if (!err)
+		err = handle_cmd(state, id, dump_argc, dump_argv);
+	free(dump_argv);
+
+	/* heapsort in place, this leaves the best record first */
+	for (n = scan_sorted.n_records - 1; n > 0; n--) {
+		tmp = scan_sorted.heap[0];
+		scan_sorted.heap[0] = scan_sorted.heap[n];
+		scan_sorted.heap[n] = tmp;
+		bss_heap_down(scan_sorted.heap, n, 0);
+	}
+
+	/* only the selected records get decoded and printed */
+	for (i = 0; i < scan_sorted.n_records; i++) {
+		if (!err)
+			print_bss(scan_sorted.heap[i].attrs,
+				  scan_sorted.heap[i].len, &scan_params);
+		free(scan_sorted.heap[i].attrs);
+	}
+	free(scan_sorted.heap);
+	memset(&scan_sorted, 0, sizeof(scan_sorted));
+
+	return err;
+}
+
+struct scan_match {
+	enum id_input id;
+	__u64 dev;		/* ifindex, or wdev id for II_WDEV */
+};
+
+static void scan_match_init(struct scan_match *match, enum id_input id,
+			    const char *dev)
+{
+	match->id = id;
+	if (id == II_WDEV)
+		match->dev = strtoull(dev, NULL, 0);
+	else
+		match->dev = if_nametoindex(dev);
+}
+
+/* are the frequencies of a scan event all among the requested ones? */
+static bool scan_event_freqs_match(struct nlattr *attr,
+				   const __u32 *freqs, int n_freqs)
+{
+	struct nlattr *nst;
+	int rem, i;
+
+	if (!n_freqs || !attr)
+		return true;
+
+	nla_for_each_nested(nst, attr, rem) {
+		for (i = 0; i < n_freqs; i++)
+			if (nla_get_u32(nst) == freqs[i])
+				break;
+		if (i == n_freqs)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Only the kernel's completion of our own scan ends the wait: it must be
+ * for our interface, and, if frequencies were requested, only for those
+ * (the kernel drops disabled channels, so the event may carry a subset).
+ * A wdev without a netdev, e.g. a P2P device, has no ifindex in its
+ * events, so those are matched by the wdev id.
+ */
+static bool match_scan_event(struct nl_msg *msg, void *priv)
+{
+	struct scan_match *match = priv;
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (match->id == II_WDEV) {
+		if (!tb[NL80211_ATTR_WDEV] ||
+		    nla_get_u64(tb[NL80211_ATTR_WDEV]) != match->dev)
+			return false;
+	} else if (!tb[NL80211_ATTR_IFINDEX] ||
+		   nla_get_u32(tb[NL80211_ATTR_IFINDEX]) != match->dev) {
+		return false;
+	}
+
+	return scan_event_freqs_match(tb[NL80211_ATTR_SCAN_FREQUENCIES],
+				      scan_req.freqs, scan_req.n_freqs);
+}
+
+/* open a socket that only receives the nl80211 scan multicast group */
+static int scan_events_open(struct nl80211_state *evstate)
+{
+	int mcid, err;
+
+	err = nl80211_init(evstate);
+	if (err)
+		return err;
+
+	mcid = nl_get_multicast_id(evstate->nl_sock, "nl80211", "scan");
+	if (mcid < 0) {
+		err = mcid;
+		goto out;
+	}
+
+	err = nl_socket_add_membership(evstate->nl_sock, mcid);
+	if (err)
+		goto out;
+
+	return 0;
+ out:
+	nl80211_cleanup(evstate);
+	return err;
+}
+
+static int handle_scan_combined(struct nl80211_state *state,
+				struct nl_cb *cb,
+				struct nl_msg *msg,
+				int argc, char **argv,
+				enum id_input id)
+{
+	char **trig_argv, *dev = argv[0], *store = NULL;
+	static char *dump_argv[] = {
+		NULL,
+		"scan",
+		"dump",
+		NULL,
+		NULL,
+		NULL,
+	};
+	static const __u32 cmds[] = {
+		NL80211_CMD_NEW_SCAN_RESULTS,
+		NL80211_CMD_SCAN_ABORTED,
+	};
+	struct nl80211_state evstate;
+	struct scan_match match;
+	struct wait_opts wait = { };
+	int trig_argc, dump_argc, err;
+	__u32 res;
+	int i;
+
+	/* strip "wlan0 scan" */
+	argc -= 2;
+	argv += 2;
+
+	dump_argc = 3;
+	while (argc) {
+		if (!strcmp(argv[0], "-u") || !strcmp(argv[0], "-b")) {
+			if (dump_argc > 3)
+				return 1;
+			dump_argv[dump_argc++] = argv[0];
+		} else if (!strcmp(argv[0], "--store")) {
+			if (argc < 2 || store)
+				return 1;
+			store = argv[1];
+			argc--;
+			argv++;
+		} else if (!strcmp(argv[0], "--timeout")) {
+			if (argc < 2 || parse_timeout(argv[1], &wait.timeout))
+				return 1;
+			argc--;
+			argv++;
+		} else
+			break;
+		argc--;
+		argv++;
+	}
+
+	/*
+	 * Subscribe to scan events on a separate socket before triggering,
+	 * so a fast completion can't be missed, and so the multicast events
+	 * don't interfere with the trigger command's own ACK processing.
+	 *
+	 * The kernel rejects a trigger while another scan is running on the
+	 * wiphy, so the next completion that matches our interface (and
+	 * requested frequencies) is for the scan we started.
+	 */
+	err = scan_events_open(&evstate);
+	if (err)
+		return err;
+
+	trig_argc = 3 + argc;
+	trig_argv = calloc(trig_argc, sizeof(*trig_argv));
+	if (!trig_argv) {
+		err = -ENOMEM;
+		goto out;
+	}
+	trig_argv[0] = dev;
+	trig_argv[1] = "scan";
+	trig_argv[2] = "trigger";
+	for (i = 0; i < argc; i++)
+		trig_argv[i + 3] = argv[i];
+	err = handle_cmd(state, id, trig_argc, trig_argv);
+	free(trig_argv);
+	if (err)
+		goto out;
+
+	scan_match_init(&match, id, dev);
+	wait.match = match_scan_event;
+	wait.priv = &match;
+
+	res = __do_listen_events(&evstate, ARRAY_SIZE(cmds), cmds, NULL, &wait);
+	nl80211_cleanup(&evstate);
+	if ((int)res < 0)
+		return res;
+	if (!res) {
+		fprintf(stderr, "scan timed out after %u.%03u seconds\n",
+			wait.elapsed / 1000, wait.elapsed % 1000);
+		return -ETIMEDOUT;
+	}
+	if (wait.timeout)
+		fprintf(stderr, "scan finished after %u.%03u seconds\n",
+			wait.elapsed / 1000, wait.elapsed % 1000);
+	if (res == NL80211_CMD_SCAN_ABORTED) {
+		printf("scan aborted!\n");
+		return 0;
+	}
+
+	dump_argv[0] = dev;
+	if (store) {
+		dump_argv[dump_argc++] = "--store";
+		dump_argv[dump_argc++] = store;
+	}
+	return handle_cmd(state, id, dump_argc, dump_argv);
+ out:
+	nl80211_cleanup(&evstate);
+	return err;
+}
+TOPLEVEL(scan, "[-u] [--timeout <seconds>] [--store <file>] [freq <freq>*] [ies <hex as 00:11:..>] [meshid <meshid>] [lowpri,flush,ap-force] [randomise[=<addr>/<mask>]] [ssid <ssid>*|passive]", 0, 0,
+	 CIB_NETDEV, handle_scan_combined,
+	 "Scan on the given frequencies and probe for the given SSIDs\n"
+	 "(or wildcard if not given) unless passive scanning is requested.\n"
+	 "If -u is specified print unknown data in the scan results.\n"
+	 "With --timeout, give up waiting for the results after the given\n"
+	 "number of seconds. With --store, record the results as for\n"
+	 "\"scan dump --store\".\n"
+	 "Specified (vendor) IEs must be well-formed.",
+	 .formats = true);
+COMMAND_ALIAS(scan, dump, "[-u|-b] [--ssid <ssid>] [--bssid <addr>] [--min-signal <dBm>] [--freq <MHz>] [--max-age <ms>]",
+	NL80211_CMD_GET_SCAN, NLM_F_DUMP, CIB_NETDEV, handle_scan_dump,
+	"Dump the current scan results. If -u is specified, print unknown\n"
+	"data in scan results, -b prints both the probe response and the\n"
+	"beacon IEs.\n"
+	"Only entries matching all of the given filters are shown.",
+	select_scan_dump_cmd, scan_dump_cmd,
+	.formats = true);
+COMMAND_ALIAS(scan, dump, "[<dump options and filters>] [--sort signal|age|freq] [--top <N>]",
+	0, 0, CIB_NETDEV, handle_scan_dump_sorted,
+	"Dump the current scan results sorted by signal (strongest first,\n"
+	"the default), age (newest first) or frequency, and with --top only\n"
+	"the first N of them.",
+	select_scan_dump_cmd, scan_dump_sorted_cmd,
+	.formats = true);
+COMMAND_ALIAS(scan, dump, "[<dump options and filters>] --diff <state file>",
+	0, 0, CIB_NETDEV, handle_scan_dump_diff,
+	"Dump only the BSSes that are new, have vanished or have changed\n"
+	"(signal in 5 dB steps, frequency, capability or IEs) since the\n"
+	"last run with the same state file, which is then updated.",
+	select_scan_dump_cmd, scan_dump_diff_cmd,
+	.formats = true);
+COMMAND_ALIAS(scan, dump, "[<dump options and filters>] --store <file>",
+	0, 0, CIB_NETDEV, handle_scan_dump_store,
+	"Also record every BSS in the dump (before filtering) in a persistent\n"
+	"store, which is created if needed. See \"scan history\" for reading it.",
+	select_scan_dump_cmd, scan_dump_store_cmd,
+	.formats = true);
+
+/*
+ * "scan list": one line per BSS. The rows are put together in a buffer
+ * with the small formatters below and written out in one go, which is
+ * a lot cheaper than the full dump for hundreds of BSSes.
+ */
+#define SCAN_LIST_ROW_LEN	256
+
+static const char hexdigits[] = "0123456789abcdef";
+
+static char *put_str(char *p, const char *str)
+{
+	while (*str)
+		*p++ = *str++;
+	return p;
+}
+
+/* right aligned in a field of the given width */
+static char *put_uint(char *p, unsigned int val, int width)
+{
+	char tmp[12];
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + val % 10;
+		val /= 10;
+	} while (val);
+
+	while (width-- > n)
+		*p++ = ' ';
+	while (n)
+		*p++ = tmp[--n];
+	return p;
+}
+
+static char *put_pad(char *p, const char *start, int width)
+{
+	while (p - start < width)
+		*p++ = ' ';
+	*p++ = ' ';
+	return p;
+}
+
+static char *put_mac(char *p, const unsigned char *addr)
+{
+	int i;
+
+	for (i = 0; i < ETH_ALEN; i++) {
+		if (i)
+			*p++ = ':';
+		*p++ = hexdigits[addr[i] >> 4];
+		*p++ = hexdigits[addr[i] & 0xf];
+	}
+	return p;
+}
+
+/*
+ * escaped like print_ssid_escaped(), stopping short of end rather than
+ * writing a partial escape
+ */
+static char *put_ssid(char *p, const char *end, const unsigned char *ssid,
+		      int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (isprint(ssid[i]) && ssid[i] != ' ' && ssid[i] != '\\') {
+			if (p + 1 > end)
+				break;
+			*p++ = ssid[i];
+		} else if (ssid[i] == ' ' && i != 0 && i != len - 1) {
+			if (p + 1 > end)
+				break;
+			*p++ = ' ';
+		} else {
+			if (p + 4 > end)
+				break;
+			*p++ = '\\';
+			*p++ = 'x';
+			*p++ = hexdigits[ssid[i] >> 4];
+			*p++ = hexdigits[ssid[i] & 0xf];
+		}
+	}
+	return p;
+}
+
+static const char *bss_security(const struct ie_model *m, __u16 capa)
+{
+	const struct ie_rsn_info *rsn = &m->rsn_info;
+	const __u32 psk = BIT(2) | BIT(4) | BIT(6);
+	const __u32 sae = BIT(8) | BIT(9);
+	const __u32 eap = BIT(1) | BIT(3) | BIT(5);
+
+	if (rsn->present) {
+		if ((rsn->akm & sae) && (rsn->akm & psk))
+			return "WPA2/3-SAE";
+		if (rsn->akm & sae)
+			return "WPA3-SAE";
+		if (rsn->akm & (BIT(11) | BIT(12)))
+			return "WPA3-EAP";
+		if (rsn->akm & BIT(18))
+			return "OWE";
+		if (rsn->akm & psk)
+			return "WPA2-PSK";
+		if (rsn->akm & eap)
+			return "WPA2-EAP";
+		return "RSN";
+	}
+
+	if (m->wpa_info.present) {
+		if (m->wpa_info.akm & BIT(2))
+			return "WPA-PSK";
+		if (m->wpa_info.akm & BIT(1))
+			return "WPA-EAP";
+		return "WPA";
+	}
+
+	if (capa & WLAN_CAPABILITY_PRIVACY)
+		return "WEP";
+	return "open";
+}
+
+static int list_bss_handler(struct nl_msg *msg, void *arg)
+{
+	struct scan_params *params = arg;
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *bss[NL80211_BSS_MAX + 1];
+	struct nlattr *ies;
+	struct ie_model m;
+	char row[SCAN_LIST_ROW_LEN], *p = row, *col;
+	unsigned int age = 0, freq = 0;
+	int signal;
+	__u16 capa = 0;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_BSS] ||
+	    nla_parse_nested(bss, NL80211_BSS_MAX, tb[NL80211_ATTR_BSS],
+			     bss_policy) ||
+	    !bss[NL80211_BSS_BSSID])
+		return NL_SKIP;
+
+	if (bss_filtered(&params->filter, bss))
+		return NL_SKIP;
+
+	if (iw_format != IW_FORMAT_TEXT)
+		return print_bss(genlmsg_attrdata(gnlh, 0),
+				 genlmsg_attrlen(gnlh, 0), params);
+
+	ies = bss[NL80211_BSS_INFORMATION_ELEMENTS];
+	if (!ies)
+		ies = bss[NL80211_BSS_BEACON_IES];
+	if (ies)
+		parse_ies(&m, nla_data(ies), nla_len(ies));
+	else
+		parse_ies(&m, NULL, 0);
+
+	if (bss[NL80211_BSS_FREQUENCY])
+		freq = nla_get_u32(bss[NL80211_BSS_FREQUENCY]);
+	if (bss[NL80211_BSS_SEEN_MS_AGO])
+		age = nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]);
+	if (bss[NL80211_BSS_CAPABILITY])
+		capa = nla_get_u16(bss[NL80211_BSS_CAPABILITY]);
+
+	p = put_mac(p, nla_data(bss[NL80211_BSS_BSSID]));
+	*p++ = ' ';
+	p = put_uint(p, freq, 5);
+	*p++ = ' ';
+	p = put_uint(p, ieee80211_frequency_to_channel(freq), 3);
+	*p++ = ' ';
+
+	col = p;
+	if (bss[NL80211_BSS_SIGNAL_MBM]) {
+		signal = (int)nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM]) / 100;
+		if (signal < 0)
+			*p++ = '-';
+		p = put_uint(p, abs(signal), 0);
+	} else if (bss[NL80211_BSS_SIGNAL_UNSPEC]) {
+		p = put_uint(p, nla_get_u8(bss[NL80211_BSS_SIGNAL_UNSPEC]), 0);
+		*p++ = '%';
+	} else
+		*p++ = '-';
+	p = put_pad(p, col, 6);
+
+	col = p;
+	p = put_uint(p, age / 1000, 0);
+	*p++ = '.';
+	*p++ = '0' + age % 1000 / 100;
+	p = put_pad(p, col, 7);
+
+	col = p;
+	p = put_uint(p, m.width ? m.width : 20, 0);
+	p = put_pad(p, col, 5);
+
+	col = p;
+	p = put_str(p, bss_security(&m, capa));
+	p = put_pad(p, col, 10);
+
+	/*
+	 * The element may claim up to 255 bytes, but an SSID has at most
+	 * 32, escaped to at most 4 characters each. Leave room for the
+	 * newline in any case.
+	 */
+	if (m.ssid.present)
+		p = put_ssid(p, row + sizeof(row) - 1, m.buf + m.ssid.off,
+			     m.ssid.len > 32 ? 32 : m.ssid.len);
+	*p++ = '\n';
+
+	fwrite(row, 1, p - row, stdout);
+	return NL_SKIP;
+}
+
+static int handle_scan_list(struct nl80211_state *state,
+			    struct nl_cb *cb,
+			    struct nl_msg *msg,
+			    int argc, char **argv,
+			    enum id_input id)
+{
+	memset(&scan_params, 0, sizeof(scan_params));
+	scan_params.type = PRINT_SCAN;
+
+	if (parse_scan_filter(&scan_params.filter, argc, argv))
+		return 1;
+
+	if (iw_format == IW_FORMAT_TEXT)
+		printf("BSSID              FREQ  CH SIGNAL AGE     WIDTH SECURITY   SSID\n");
+
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, list_bss_handler,
+		  &scan_params);
+	return 0;
+}
+COMMAND(scan, list, "[--ssid <ssid>] [--bssid <addr>] [--min-signal <dBm>] [--freq <MHz>] [--max-age <ms>]",
+	NL80211_CMD_GET_SCAN, NLM_F_DUMP, CIB_NETDEV, handle_scan_list,
+	"List the current scan results, one line per BSS: BSSID, frequency,\n"
+	"channel, signal in dBm, seconds since last seen, channel width in\n"
+	"MHz, security and SSID. The filters are those of \"scan dump\".",
+	.formats = true);
+COMMAND(scan, trigger, "[freq <freq>*] [ies <hex as 00:11:..>] [meshid <meshid>] [lowpri,flush,ap-force] [randomise[=<addr>/<mask>]] [ssid <ssid>*|passive]",
+	NL80211_CMD_TRIGGER_SCAN, 0, CIB_NETDEV, handle_scan,
+	 "Trigger a scan on the given frequencies with probing for the given\n"
+	 "SSIDs (or wildcard if not given) unless passive scanning is requested.");
+
+static const struct cmd *scan_sched_start;
+static const struct cmd *scan_sched_stop;
+
+static const struct cmd *select_scan_sched_cmd(int argc, char **argv)
+{
+	if (argc < 1)
+		return NULL;
+	if (strcmp(argv[0], "start") == 0)
+		return scan_sched_start;
+	if (strcmp(argv[0], "stop") == 0)
+		return scan_sched_stop;
+	return NULL;
+}
+
+static int handle_scan_sched_start(struct nl80211_state *state,
+				   struct nl_cb *cb,
+				   struct nl_msg *msg,
+				   int argc, char **argv,
+				   enum id_input id)
+{
+	struct nl_msg *ssids = NULL, *freqs = NULL, *matches = NULL;
+	struct nlattr *match = NULL;
+	enum {
+		NONE,
+		FREQ,
+		SSID,
+		MATCH,
+	} parse = NONE;
+	bool passive = false, have_ssids = false, have_freqs = false;
+	unsigned int interval = 0, freq;
+	int n_ssids = 0, n_freqs = 0, n_matches = 0;
+	int err = -ENOBUFS;
+	char *end;
+	int i;
+
+	/* skip "start" */
+	argc--;
+	argv++;
+
+	ssids = nlmsg_alloc();
+	freqs = nlmsg_alloc();
+	matches = nlmsg_alloc();
+	if (!ssids || !freqs || !matches) {
+		err = -ENOMEM;
+		goto nla_put_failure;
+	}
+
+	for (i = 0; i < argc; i++) {
+		if (strcmp(argv[i], "interval") == 0 && i + 1 < argc) {
+			interval = strtoul(argv[++i], &end, 10);
+			if (*end || !interval)
+				goto usage;
+			parse = NONE;
+		} else if (strcmp(argv[i], "freq") == 0) {
+			parse = FREQ;
+			have_freqs = true;
+		} else if (strcmp(argv[i], "passive") == 0) {
+			passive = true;
+			parse = NONE;
+		} else if (strcmp(argv[i], "match") == 0) {
+			if (match)
+				nla_nest_end(matches, match);
+			match = nla_nest_start(matches, ++n_matches);
+			if (!match)
+				goto nla_put_failure;
+			parse = MATCH;
+		} else if (parse == MATCH && i + 1 < argc &&
+			   strcmp(argv[i], "ssid") == 0) {
+			i++;
+			NLA_PUT(matches, NL80211_SCHED_SCAN_MATCH_ATTR_SSID,
+				strlen(argv[i]), argv[i]);
+		} else if (parse == MATCH && i + 1 < argc &&
+			   strcmp(argv[i], "rssi") == 0) {
+			i++;
+			NLA_PUT_U32(matches, NL80211_SCHED_SCAN_MATCH_ATTR_RSSI,
+				    strtol(argv[i], &end, 10));
+			if (*end)
+				goto usage;
+		} else if (parse != MATCH && strcmp(argv[i], "ssid") == 0) {
+			parse = SSID;
+			have_ssids = true;
+		} else if (parse == FREQ) {
+			freq = strtoul(argv[i], &end, 10);
+			if (*end)
+				goto usage;
+			NLA_PUT_U32(freqs, ++n_freqs, freq);
+		} else if (parse == SSID) {
+			NLA_PUT(ssids, ++n_ssids, strlen(argv[i]), argv[i]);
+		} else
+			goto usage;
+	}
+
+	if (match)
+		nla_nest_end(matches, match);
+
+	if (!interval || (passive && have_ssids) ||
+	    (have_freqs && !n_freqs) || (have_ssids && !n_ssids))
+		goto usage;
+
+	NLA_PUT_U32(msg, NL80211_ATTR_SCHED_SCAN_INTERVAL, interval);
+
+	/* without any SSIDs the scan is passive, so probe the wildcard */
+	if (!have_ssids)
+		NLA_PUT(ssids, 1, 0, "");
+	if (!passive)
+		nla_put_nested(msg, NL80211_ATTR_SCAN_SSIDS, ssids);
+	if (have_freqs)
+		nla_put_nested(msg, NL80211_ATTR_SCAN_FREQUENCIES, freqs);
+	if (n_matches)
+		nla_put_nested(msg, NL80211_ATTR_SCHED_SCAN_MATCH, matches);
+
+	err = 0;
+ nla_put_failure:
+	nlmsg_free(ssids);
+	nlmsg_free(freqs);
+	nlmsg_free(matches);
+	return err;
+ usage:
+	err = 1;
+	goto nla_put_failure;
+}
+COMMAND_ALIAS(scan, sched, "start interval <ms> [freq <freq>*] [ssid <ssid>*|passive] [match [ssid <ssid>] [rssi <dBm>]]*",
+	NL80211_CMD_START_SCHED_SCAN, 0, CIB_NETDEV, handle_scan_sched_start,
+	"Start a scheduled scan, which is offloaded to the device and repeated\n"
+	"every <interval> ms, on the given frequencies with probing for the\n"
+	"given SSIDs (or wildcard if not given) unless passive scanning is\n"
+	"requested. Each match starts a set of SSID and/or RSSI threshold\n"
+	"that a BSS has to fulfil to be reported; these come last.\n"
+	"Results are announced by the scheduled scan results event.",
+	select_scan_sched_cmd, scan_sched_start);
+
+static int handle_scan_sched_stop(struct nl80211_state *state,
+				  struct nl_cb *cb,
+				  struct nl_msg *msg,
+				  int argc, char **argv,
+				  enum id_input id)
+{
+	if (argc != 1)
+		return 1;
+	return 0;
+}
+COMMAND_ALIAS(scan, sched, "stop",
+	NL80211_CMD_STOP_SCHED_SCAN, 0, CIB_NETDEV, handle_scan_sched_stop,
+	"Stop a running scheduled scan.",
+	select_scan_sched_cmd, scan_sched_stop);
+
+/*
+ * The enabled channels of an interface's wiphy, for the commands that
+ * plan their own scans ("iw dev wlan0 scan freqs" fills this in).
+ */
+static struct {
+	__u32 wiphy;
+	int n_freqs;
+	__u32 freqs[SCAN_REQ_MAX_FREQS];
+} scan_chans;
+
+static int scan_freqs_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *tb_band[NL80211_BAND_ATTR_MAX + 1];
+	struct nlattr *tb_freq[NL80211_FREQUENCY_ATTR_MAX + 1];
+	struct nlattr *nl_band, *nl_freq;
+	int rem_band, rem_freq;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (tb[NL80211_ATTR_WIPHY])
+		scan_chans.wiphy = nla_get_u32(tb[NL80211_ATTR_WIPHY]);
+
+	if (!tb[NL80211_ATTR_WIPHY_BANDS])
+		return NL_SKIP;
+
+	nla_for_each_nested(nl_band, tb[NL80211_ATTR_WIPHY_BANDS], rem_band) {
+		nla_parse(tb_band, NL80211_BAND_ATTR_MAX, nla_data(nl_band),
+			  nla_len(nl_band), NULL);
+		if (!tb_band[NL80211_BAND_ATTR_FREQS])
+			continue;
+
+		nla_for_each_nested(nl_freq, tb_band[NL80211_BAND_ATTR_FREQS], rem_freq) {
+			nla_parse(tb_freq, NL80211_FREQUENCY_ATTR_MAX,
+				  nla_data(nl_freq), nla_len(nl_freq), NULL);
+			if (!tb_freq[NL80211_FREQUENCY_ATTR_FREQ] ||
+			    tb_freq[NL80211_FREQUENCY_ATTR_DISABLED] ||
+			    scan_chans.n_freqs == SCAN_REQ_MAX_FREQS)
+				continue;
+			scan_chans.freqs[scan_chans.n_freqs++] =
+				nla_get_u32(tb_freq[NL80211_FREQUENCY_ATTR_FREQ]);
+		}
+	}
+
+	return NL_SKIP;
+}
+
+static int handle_scan_freqs(struct nl80211_state *state,
+			     struct nl_cb *cb,
+			     struct nl_msg *msg,
+			     int argc, char **argv,
+			     enum id_input id)
+{
+	memset(&scan_chans, 0, sizeof(scan_chans));
+	/* a split dump is filtered down to our interface's wiphy */
+	NLA_PUT_FLAG(msg, NL80211_ATTR_SPLIT_WIPHY_DUMP);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, scan_freqs_handler, NULL);
+	return 0;
+ nla_put_failure:
+	return -ENOBUFS;
+}
+HIDDEN(scan, freqs, "", NL80211_CMD_GET_WIPHY, NLM_F_DUMP, CIB_NETDEV,
+       handle_scan_freqs);
+
+/*
+ * scan monitor: keep scanning in small frequency chunks instead of full
+ * passes, so the radio is never off channel for long, and keep a table
+ * of the BSSes seen. Channels that had BSSes on them recently are
+ * visited more often than quiet ones.
+ */
+
+#define MONITOR_MAX_CHANS	64
+#define MONITOR_ACTIVITY_MAX	8
+
+struct monitor_chan {
+	__u32 freq;
+	unsigned int n_bss;		/* seen in the last visit */
+	unsigned long long last_scan;	/* ms, 0 if never */
+};
+
+struct monitor_bss {
+	unsigned char bssid[ETH_ALEN];
+	__u8 ssid_len;
+	char ssid[32];
+	__u32 freq;
+	int signal;			/* mBm */
+	unsigned long long last_seen;	/* ms */
+};
+
+static struct {
+	int n_chans;
+	struct monitor_chan chans[MONITOR_MAX_CHANS];
+	int n_bss, size;
+	struct monitor_bss *bss;
+	/* the chunk being dumped */
+	const __u32 *scanned;
+	int n_scanned;
+	unsigned long long scan_start;
+} scan_mon;
+
+static unsigned long long monitor_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+
+static void print_monitor_bss(const char *what, struct monitor_bss *b)
+{
+	char mac_addr[20];
+
+	mac_addr_n2a(mac_addr, b->bssid);
+	if (iw_format != IW_FORMAT_TEXT) {
+		fmt_obj_begin(NULL);
+		fmt_str("change", what);
+		fmt_mac("bssid", b->bssid);
+		fmt_ssid("ssid", (const __u8 *)b->ssid, b->ssid_len);
+		fmt_uint("freq", b->freq);
+		fmt_int("signal_mbm", b->signal);
+		fmt_obj_end();
+	} else {
+		printf("%s %s freq %u signal %d.%.2d dBm SSID ", what, mac_addr,
+		       b->freq, b->signal / 100, abs(b->signal % 100));
+		print_ssid_escaped(b->ssid_len, (const uint8_t *)b->ssid);
+		printf("\n");
+	}
+	fflush(stdout);
+}
+
+static int monitor_bss_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *bss[NL80211_BSS_MAX + 1];
+	struct monitor_bss *b;
+	struct ie_model m;
+	unsigned long long now = monitor_now();
+	__u32 freq;
+	int i, size;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_BSS] ||
+	    nla_parse_nested(bss, NL80211_BSS_MAX, tb[NL80211_ATTR_BSS],
+			     bss_policy) ||
+	    !bss[NL80211_BSS_BSSID] || !bss[NL80211_BSS_FREQUENCY])
+		return NL_SKIP;
+
+	/* only take what this pass has actually seen, not the cache */
+	if (bss[NL80211_BSS_SEEN_MS_AGO] &&
+	    nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]) > now - scan_mon.scan_start)
+		return NL_SKIP;
+
+	freq = nla_get_u32(bss[NL80211_BSS_FREQUENCY]);
+	for (i = 0; i < scan_mon.n_scanned; i++)
+		if (scan_mon.scanned[i] == freq)
+			break;
+	if (i == scan_mon.n_scanned)
+		return NL_SKIP;
+
+	for (i = 0; i < scan_mon.n_chans; i++)
+		if (scan_mon.chans[i].freq == freq)
+			scan_mon.chans[i].n_bss++;
+
+	for (i = 0; i < scan_mon.n_bss; i++)
+		if (!memcmp(scan_mon.bss[i].bssid,
+			    nla_data(bss[NL80211_BSS_BSSID]), ETH_ALEN))
+			break;
+
+	if (i == scan_mon.n_bss) {
+		if (scan_mon.n_bss == scan_mon.size) {
+			size = scan_mon.size ? 2 * scan_mon.size : 64;
+			b = realloc(scan_mon.bss, size * sizeof(*b));
+			if (!b)
+				return NL_SKIP;
+			scan_mon.bss = b;
+			scan_mon.size = size;
+		}
+		b = &scan_mon.bss[scan_mon.n_bss++];
+		memset(b, 0, sizeof(*b));
+		memcpy(b->bssid, nla_data(bss[NL80211_BSS_BSSID]), ETH_ALEN);
+	} else
+		b = &scan_mon.bss[i];
+
+	b->freq = freq;
+	if (bss[NL80211_BSS_SIGNAL_MBM])
+		b->signal = (int)nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM]);
+	if (bss[NL80211_BSS_INFORMATION_ELEMENTS]) {
+		parse_ies(&m, nla_data(bss[NL80211_BSS_INFORMATION_ELEMENTS]),
+			  nla_len(bss[NL80211_BSS_INFORMATION_ELEMENTS]));
+		if (m.ssid.present) {
+			/* the element may claim up to 255 bytes */
+			b->ssid_len = m.ssid.len;
+			if (b->ssid_len > sizeof(b->ssid))
+				b->ssid_len = sizeof(b->ssid);
+			memcpy(b->ssid, m.buf + m.ssid.off, b->ssid_len);
+		}
+	}
+
+	if (!b->last_seen)
+		print_monitor_bss("new", b);
+	b->last_seen = now;
+
+	return NL_SKIP;
+}
+
+static int handle_scan_monitor_dump(struct nl80211_state *state,
+				    struct nl_cb *cb,
+				    struct nl_msg *msg,
+				    int argc, char **argv,
+				    enum id_input id)
+{
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, monitor_bss_handler, NULL);
+	return 0;
+}
+HIDDEN(scan, monitor_dump, "", NL80211_CMD_GET_SCAN, NLM_F_DUMP, CIB_NETDEV,
+       handle_scan_monitor_dump);
+
+/*
+ * Channels never visited come first, then the one that has waited the
+ * longest, weighted by how busy it was at the last visit.
+ */
+static unsigned long long monitor_chan_prio(struct monitor_chan *c,
+					    unsigned long long now)
+{
+	unsigned int activity = c->n_bss;
+
+	if (!c->last_scan)
+		return ULLONG_MAX;
+	if (activity > MONITOR_ACTIVITY_MAX)
+		activity = MONITOR_ACTIVITY_MAX;
+	return (now - c->last_scan) * (1 + activity);
+}
+
+static int monitor_pick(__u32 *freqs, int chunk, unsigned long long now)
+{
+	bool picked[MONITOR_MAX_CHANS] = { };
+	unsigned long long prio, best_prio;
+	int n, i, best;
+
+	for (n = 0; n < chunk && n < scan_mon.n_chans; n++) {
+		best = -1;
+		best_prio = 0;
+		for (i = 0; i < scan_mon.n_chans; i++) {
+			prio = monitor_chan_prio(&scan_mon.chans[i], now);
+			if (picked[i] || (best >= 0 && prio <= best_prio))
+				continue;
+			best = i;
+			best_prio = prio;
+		}
+		picked[best] = true;
+		freqs[n] = scan_mon.chans[best].freq;
+		scan_mon.chans[best].last_scan = now;
+		scan_mon.chans[best].n_bss = 0;
+	}
+
+	return n;
+}
+
+static void monitor_expire(unsigned long long now, unsigned int expire)
+{
 	int i;
-	for (i = 0; i < argc - 2 - (dump_argc - 3); i++)
-		trig_argv[i + 3] = argv[i + 2 + (dump_argc - 3)];
-	err = handle_cmd(state, id, trig_argc, trig_argv);
-	free(trig_argv);
+
+	for (i = 0; i < scan_mon.n_bss; i++) {
+		if (now - scan_mon.bss[i].last_seen < expire)
+			continue;
+		print_monitor_bss("lost", &scan_mon.bss[i]);
+		scan_mon.bss[i--] = scan_mon.bss[--scan_mon.n_bss];
+	}
+}
+
+static int handle_scan_monitor(struct nl80211_state *state,
+			       struct nl_cb *cb,
+			       struct nl_msg *msg,
+			       int argc, char **argv,
+			       enum id_input id)
+{
+	static const __u32 cmds[] = {
+		NL80211_CMD_NEW_SCAN_RESULTS,
+		NL80211_CMD_SCAN_ABORTED,
+	};
+	char *dev = argv[0], *end;
+	char *freqs_argv[] = { dev, "scan", "freqs" };
+	char *dump_argv[] = { dev, "scan", "monitor_dump" };
+	char *trig_argv[4 + MONITOR_MAX_CHANS];
+	char freq_buf[MONITOR_MAX_CHANS][12];
+	__u32 freqs[MONITOR_MAX_CHANS];
+	unsigned int chunk = 3, interval = 500, expire = 60000, passes = 0;
+	unsigned int pass;
+	struct nl80211_state evstate;
+	struct scan_match match;
+	struct wait_opts wait = { .timeout = 10000 };
+	unsigned long long now;
+	int err, i, n;
+	__u32 res;
+
+	/* strip "wlan0 scan monitor" */
+	argc -= 3;
+	argv += 3;
+
+	memset(&scan_mon, 0, sizeof(scan_mon));
+
+	for (; argc; argc--, argv++) {
+		unsigned long val;
+
+		if (strcmp(argv[0], "freq") == 0) {
+			while (argc > 1 && scan_mon.n_chans < MONITOR_MAX_CHANS) {
+				val = strtoul(argv[1], &end, 10);
+				if (*end)
+					break;
+				scan_mon.chans[scan_mon.n_chans++].freq = val;
+				argc--;
+				argv++;
+			}
+			continue;
+		}
+
+		if (argc < 2)
+			return 1;
+		val = strtoul(argv[1], &end, 10);
+		if (*end || !val)
+			return 1;
+		if (strcmp(argv[0], "--chunk") == 0 && val <= MONITOR_MAX_CHANS)
+			chunk = val;
+		else if (strcmp(argv[0], "--interval") == 0)
+			interval = val;
+		else if (strcmp(argv[0], "--expire") == 0)
+			expire = val * 1000;
+		else if (strcmp(argv[0], "--passes") == 0)
+			passes = val;
+		else
+			return 1;
+		argc--;
+		argv++;
+	}
+
+	if (!scan_mon.n_chans) {
+		err = handle_cmd(state, id, ARRAY_SIZE(freqs_argv), freqs_argv);
+		if (err)
+			return err;
+		for (i = 0; i < scan_chans.n_freqs &&
+			    scan_mon.n_chans < MONITOR_MAX_CHANS; i++)
+			scan_mon.chans[scan_mon.n_chans++].freq =
+				scan_chans.freqs[i];
+		if (!scan_mon.n_chans) {
+			fprintf(stderr, "no usable channels found\n");
+			return -ENOENT;
+		}
+	}
+
+	err = scan_events_open(&evstate);
 	if (err)
 		return err;
 
+	scan_match_init(&match, id, dev);
+	wait.match = match_scan_event;
+	wait.priv = &match;
+
+	for (pass = 0; !passes || pass < passes; pass++) {
+		now = monitor_now();
+		n = monitor_pick(freqs, chunk, now);
+
+		trig_argv[0] = dev;
+		trig_argv[1] = "scan";
+		trig_argv[2] = "trigger";
+		trig_argv[3] = "freq";
+		for (i = 0; i < n; i++) {
+			snprintf(freq_buf[i], sizeof(freq_buf[i]), "%u", freqs[i]);
+			trig_argv[4 + i] = freq_buf[i];
+		}
+
+		scan_mon.scan_start = now;
+		err = handle_cmd(state, id, 4 + n, trig_argv);
+		if (err == -EBUSY) {
+			/* someone else is scanning, try again later */
+			usleep(interval * 1000);
+			continue;
+		}
+		if (err)
+			break;
+
+		res = __do_listen_events(&evstate, ARRAY_SIZE(cmds), cmds,
+					 NULL, &wait);
+		if ((int)res < 0) {
+			err = res;
+			break;
+		}
+		if (res == NL80211_CMD_NEW_SCAN_RESULTS) {
+			scan_mon.scanned = freqs;
+			scan_mon.n_scanned = n;
+			err = handle_cmd(state, id, ARRAY_SIZE(dump_argv),
+					 dump_argv);
+			if (err)
+				break;
+		}
+
+		monitor_expire(monitor_now(), expire);
+		usleep(interval * 1000);
+	}
+
+	nl80211_cleanup(&evstate);
+	free(scan_mon.bss);
+	memset(&scan_mon, 0, sizeof(scan_mon));
+	return err;
+}
+COMMAND(scan, monitor, "[--chunk <n>] [--interval <ms>] [--expire <s>] [--passes <n>] [freq <freq>*]",
+	0, 0, CIB_NETDEV, handle_scan_monitor,
+	"Scan continuously, a few channels at a time (--chunk, default 3)\n"
+	"with a pause of --interval ms (default 500) between them, and print\n"
+	"BSSes as they appear or haven't been seen for --expire seconds\n"
+	"(default 60). Channels with more BSSes at the last visit are scanned\n"
+	"more often. Runs forever unless a number of --passes is given.",
+	.formats = true);
+
+/*
+ * Scanning with several radios at once: the channels are split between
+ * the devices (each one only gets channels its wiphy supports, spread so
+ * that all get about the same number), all scans are triggered before
+ * waiting for any of them, and the results of all devices are printed
+ * as one list with a BSS seen by more than one radio shown only once.
+ */
+#define SCAN_MULTI_MAX_DEVS	16
+
+struct scan_multi_dev {
+	const char *name;
+	__u32 ifindex, wiphy;
+	int n_chans;		/* supported */
+	__u32 chans[SCAN_REQ_MAX_FREQS];
+	int n_freqs;		/* assigned to this device */
+	char *freqs_argv[SCAN_REQ_MAX_FREQS];
+	__u32 freqs[SCAN_REQ_MAX_FREQS];
+	bool pending, done;
+};
+
+struct scan_multi_bss {
+	unsigned char bssid[ETH_ALEN];
+	__u32 freq;
+	__u32 seen_ms_ago;
+	int len;
+	void *attrs;		/* copy of the message attributes */
+};
+
+static struct {
+	int n_devs;
+	struct scan_multi_dev devs[SCAN_MULTI_MAX_DEVS];
+	struct scan_multi_dev *completed;
+	int n_bss, size;
+	struct scan_multi_bss *bss;
+} scan_multi;
+
+static bool match_multi_scan_event(struct nl_msg *msg, void *priv)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct scan_multi_dev *dev;
+	__u32 ifindex;
+	int i;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_IFINDEX])
+		return false;
+	ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+
+	for (i = 0; i < scan_multi.n_devs; i++) {
+		dev = &scan_multi.devs[i];
+		if (!dev->pending || dev->ifindex != ifindex)
+			continue;
+		if (!scan_event_freqs_match(tb[NL80211_ATTR_SCAN_FREQUENCIES],
+					    dev->freqs, dev->n_freqs))
+			return false;
+		scan_multi.completed = dev;
+		return true;
+	}
+
+	return false;
+}
+
+static int merge_bss_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *bss[NL80211_BSS_MAX + 1];
+	struct scan_multi_bss rec, *b = NULL;
+	int i, size;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_BSS] ||
+	    nla_parse_nested(bss, NL80211_BSS_MAX, tb[NL80211_ATTR_BSS],
+			     bss_policy) ||
+	    !bss[NL80211_BSS_BSSID])
+		return NL_SKIP;
+
+	memcpy(rec.bssid, nla_data(bss[NL80211_BSS_BSSID]), ETH_ALEN);
+	rec.freq = 0;
+	if (bss[NL80211_BSS_FREQUENCY])
+		rec.freq = nla_get_u32(bss[NL80211_BSS_FREQUENCY]);
+	rec.seen_ms_ago = 0;
+	if (bss[NL80211_BSS_SEEN_MS_AGO])
+		rec.seen_ms_ago = nla_get_u32(bss[NL80211_BSS_SEEN_MS_AGO]);
+
+	/* a BSS heard by several radios: keep the most recent sighting */
+	for (i = 0; i < scan_multi.n_bss; i++) {
+		if (scan_multi.bss[i].freq == rec.freq &&
+		    !memcmp(scan_multi.bss[i].bssid, rec.bssid, ETH_ALEN)) {
+			b = &scan_multi.bss[i];
+			break;
+		}
+	}
+	if (b && b->seen_ms_ago <= rec.seen_ms_ago)
+		return NL_SKIP;
+
+	rec.len = genlmsg_attrlen(gnlh, 0);
+	rec.attrs = malloc(rec.len);
+	if (!rec.attrs)
+		return NL_SKIP;
+	memcpy(rec.attrs, genlmsg_attrdata(gnlh, 0), rec.len);
+
+	if (b) {
+		free(b->attrs);
+		*b = rec;
+		return NL_SKIP;
+	}
+
+	if (scan_multi.n_bss == scan_multi.size) {
+		size = scan_multi.size ? 2 * scan_multi.size : 32;
+		b = realloc(scan_multi.bss, size * sizeof(*b));
+		if (!b) {
+			free(rec.attrs);
+			return NL_SKIP;
+		}
+		scan_multi.bss = b;
+		scan_multi.size = size;
+	}
+	scan_multi.bss[scan_multi.n_bss++] = rec;
+
+	return NL_SKIP;
+}
+
+static int handle_scan_merge_dump(struct nl80211_state *state,
+				  struct nl_cb *cb,
+				  struct nl_msg *msg,
+				  int argc, char **argv,
+				  enum id_input id)
+{
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, merge_bss_handler, NULL);
+	return 0;
+}
+HIDDEN(scan, merge_dump, "", NL80211_CMD_GET_SCAN, NLM_F_DUMP, CIB_NETDEV,
+       handle_scan_merge_dump);
+
+static int scan_multi_add_dev(struct nl80211_state *state, const char *name,
+			      bool quiet)
+{
+	char *freqs_argv[] = { (char *)name, "scan", "freqs" };
+	struct scan_multi_dev *dev;
+	int i, err;
+
+	if (scan_multi.n_devs == SCAN_MULTI_MAX_DEVS)
+		return -E2BIG;
+
+	err = handle_cmd(state, II_NETDEV, ARRAY_SIZE(freqs_argv), freqs_argv);
+	if (err) {
+		if (!quiet)
+			fprintf(stderr, "%s: no channel list (%d)\n", name, err);
+		return err;
+	}
+
+	/* interfaces of one wiphy can't scan at the same time */
+	for (i = 0; i < scan_multi.n_devs; i++) {
+		if (scan_multi.devs[i].wiphy != scan_chans.wiphy)
+			continue;
+		if (!quiet)
+			fprintf(stderr, "%s: same radio as %s, skipped\n",
+				name, scan_multi.devs[i].name);
+		return 0;
+	}
+
+	dev = &scan_multi.devs[scan_multi.n_devs++];
+	memset(dev, 0, sizeof(*dev));
+	dev->name = name;
+	dev->ifindex = if_nametoindex(name);
+	dev->wiphy = scan_chans.wiphy;
+	dev->n_chans = scan_chans.n_freqs;
+	memcpy(dev->chans, scan_chans.freqs,
+	       scan_chans.n_freqs * sizeof(dev->chans[0]));
+	return 0;
+}
+
+static bool freq_listed(const __u32 *freqs, int n_freqs, __u32 freq)
+{
+	int i;
+
+	for (i = 0; i < n_freqs; i++)
+		if (freqs[i] == freq)
+			return true;
+	return false;
+}
+
+/* give each frequency to the least loaded device that supports it */
+static void scan_multi_assign(__u32 freq, char *arg)
+{
+	struct scan_multi_dev *dev, *best = NULL;
+	int i;
+
+	for (i = 0; i < scan_multi.n_devs; i++) {
+		dev = &scan_multi.devs[i];
+		if (best && dev->n_freqs >= best->n_freqs)
+			continue;
+		if (freq_listed(dev->chans, dev->n_chans, freq))
+			best = dev;
+	}
+
+	if (!best) {
+		fprintf(stderr, "no device can scan on %u MHz\n", freq);
+		return;
+	}
+	best->freqs_argv[best->n_freqs] = arg;
+	best->freqs[best->n_freqs++] = freq;
+}
+
+static int handle_scan_multi(struct nl80211_state *state,
+			     struct nl_cb *cb,
+			     struct nl_msg *msg,
+			     int argc, char **argv,
+			     enum id_input id)
+{
+	static const __u32 cmds[] = {
+		NL80211_CMD_NEW_SCAN_RESULTS,
+		NL80211_CMD_SCAN_ABORTED,
+	};
+	static char freq_buf[SCAN_REQ_MAX_FREQS][12];
+	char **opt_argv = NULL, **trig_argv = NULL, *end;
+	char *dump_argv[] = { NULL, "scan", "merge_dump" };
+	__u32 freqs[SCAN_REQ_MAX_FREQS];
+	struct scan_multi_dev *dev;
+	struct nl80211_state evstate;
+	struct ifcache ifc = { };
+	struct wait_opts wait = { };
+	unsigned int timeout = 0, elapsed = 0;
+	int n_freqs = 0, opt_argc = 0, pending = 0;
+	bool all = false, have_freqs = false;
+	int i, j, err, wait_err = 0;
+	__u32 res;
+
+	memset(&scan_multi, 0, sizeof(scan_multi));
+	memset(&scan_params, 0, sizeof(scan_params));
+	scan_params.type = PRINT_SCAN;
+
+	/* strip "scan" */
+	argc--;
+	argv++;
+
+	for (; argc; argc--, argv++) {
+		if (!strcmp(argv[0], "--all")) {
+			all = true;
+		} else if (!strcmp(argv[0], "-u")) {
+			scan_params.unknown = true;
+		} else if (!strcmp(argv[0], "-b")) {
+			scan_params.show_both_ie_sets = true;
+		} else if (!strcmp(argv[0], "--timeout")) {
+			if (argc < 2 || parse_timeout(argv[1], &timeout))
+				return 1;
+			argc--;
+			argv++;
+		} else if (argv[0][0] != '-' && if_nametoindex(argv[0])) {
+			err = scan_multi_add_dev(state, argv[0], false);
+			if (err)
+				goto out;
+		} else
+			break;
+	}
+
+	if (all) {
+		if (scan_multi.n_devs)
+			return 1;
+		err = ifcache_fill(&ifc, state);
+		if (err)
+			return err;
+		for (i = 0; i < ifc.n_entries; i++)
+			scan_multi_add_dev(state, ifc.entries[i]->name, true);
+	}
+
+	if (!scan_multi.n_devs) {
+		fprintf(stderr, "no device to scan with\n");
+		err = -ENODEV;
+		goto out;
+	}
+
 	/*
-	 * WARNING: DO NOT COPY THIS CODE INTO YOUR APPLICATION
-	 *
-	 * This code has a bug, which requires creating a separate
-	 * nl80211 socket to fix:
-	 * It is possible for a NL80211_CMD_NEW_SCAN_RESULTS or
-	 * NL80211_CMD_SCAN_ABORTED message to be sent by the kernel
-	 * before (!) we listen to it, because we only start listening
-	 * after we send our scan request.
-	 *
-	 * Doing it the other way around has a race condition as well,
-	 * if you first open the events socket you may get a notification
-	 * for a previous scan.
-	 *
-	 * The only proper way to fix this would be to listen to events
-	 * before sending the command, and for the kernel to send the
-	 * scan request along with the event, so that you can match up
-	 * whether the scan you requested was finished or aborted (this
-	 * may result in processing a scan that another application
-	 * requested, but that doesn't seem to be a problem).
-	 *
-	 * Alas, the kernel doesn't do that (yet).
+	 * Take the frequencies out of the scan options, everything else is
+	 * given to each device's trigger. SSIDs must come last there, so
+	 * anything after "ssid" is left alone.
 	 */
+	opt_argv = calloc(argc, sizeof(*opt_argv));
+	if (!opt_argv && argc) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < argc; i++) {
+		if (!strcmp(argv[i], "freq")) {
+			have_freqs = true;
+			j = n_freqs;
+			while (i + 1 < argc && n_freqs < SCAN_REQ_MAX_FREQS) {
+				freqs[n_freqs] = strtoul(argv[i + 1], &end, 10);
+				if (*end)
+					break;
+				n_freqs++;
+				i++;
+			}
+			/* "freq" without any would scan nothing */
+			if (j == n_freqs) {
+				err = 1;
+				goto out;
+			}
+			continue;
+		}
+		opt_argv[opt_argc++] = argv[i];
+		if ((!strcmp(argv[i], "ies") || !strcmp(argv[i], "meshid")) &&
+		    i + 1 < argc) {
+			opt_argv[opt_argc++] = argv[++i];
+		} else if (!strcmp(argv[i], "ssid") ||
+			   !strcmp(argv[i], "passive")) {
+			while (++i < argc)
+				opt_argv[opt_argc++] = argv[i];
+		}
+	}
 
-	if (listen_events(state, ARRAY_SIZE(cmds), cmds) ==
-					NL80211_CMD_SCAN_ABORTED) {
-		printf("scan aborted!\n");
+	/* no frequencies given: everything any of the devices supports */
+	if (!have_freqs) {
+		for (i = 0; i < scan_multi.n_devs; i++) {
+			dev = &scan_multi.devs[i];
+			for (j = 0; j < dev->n_chans; j++)
+				if (n_freqs < SCAN_REQ_MAX_FREQS &&
+				    !freq_listed(freqs, n_freqs, dev->chans[j]))
+					freqs[n_freqs++] = dev->chans[j];
+		}
+	}
+
+	for (i = 0; i < n_freqs; i++) {
+		snprintf(freq_buf[i], sizeof(freq_buf[i]), "%u", freqs[i]);
+		scan_multi_assign(freqs[i], freq_buf[i]);
+	}
+
+	err = scan_events_open(&evstate);
+	if (err)
+		goto out;
+
+	trig_argv = calloc(4 + SCAN_REQ_MAX_FREQS + opt_argc, sizeof(*trig_argv));
+	if (!trig_argv) {
+		err = -ENOMEM;
+		goto out_events;
+	}
+
+	for (i = 0; i < scan_multi.n_devs; i++) {
+		dev = &scan_multi.devs[i];
+		if (!dev->n_freqs)
+			continue;
+
+		trig_argv[0] = (char *)dev->name;
+		trig_argv[1] = "scan";
+		trig_argv[2] = "trigger";
+		trig_argv[3] = "freq";
+		memcpy(&trig_argv[4], dev->freqs_argv,
+		       dev->n_freqs * sizeof(*trig_argv));
+		memcpy(&trig_argv[4 + dev->n_freqs], opt_argv,
+		       opt_argc * sizeof(*trig_argv));
+
+		err = handle_cmd(state, II_NETDEV, 4 + dev->n_freqs + opt_argc,
+				 trig_argv);
+		if (err == 1)
+			goto out_events;
+		if (err) {
+			fprintf(stderr, "%s: scan failed (%d)\n", dev->name, err);
+			continue;
+		}
+		dev->pending = true;
+		pending++;
+	}
+	err = 0;
+
+	wait.match = match_multi_scan_event;
+	while (pending) {
+		if (timeout) {
+			if (elapsed >= timeout)
+				break;
+			wait.timeout = timeout - elapsed;
+		}
+		res = __do_listen_events(&evstate, ARRAY_SIZE(cmds), cmds,
+					 NULL, &wait);
+		elapsed += wait.elapsed;
+		if ((int)res < 0)
+			wait_err = res;
+		if ((int)res <= 0)
+			break;
+
+		dev = scan_multi.completed;
+		dev->pending = false;
+		pending--;
+		if (res == NL80211_CMD_SCAN_ABORTED)
+			fprintf(stderr, "%s: scan aborted!\n", dev->name);
+		else
+			dev->done = true;
+	}
+
+	for (i = 0; i < scan_multi.n_devs; i++) {
+		dev = &scan_multi.devs[i];
+		if (dev->pending && wait_err) {
+			fprintf(stderr, "%s: waiting for the scan failed: %s\n",
+				dev->name, strerror(-wait_err));
+			err = wait_err;
+		} else if (dev->pending) {
+			fprintf(stderr, "%s: scan timed out after %u.%03u seconds\n",
+				dev->name, elapsed / 1000, elapsed % 1000);
+			err = -ETIMEDOUT;
+		}
+		if (!dev->done)
+			continue;
+		dump_argv[0] = (char *)dev->name;
+		handle_cmd(state, II_NETDEV, ARRAY_SIZE(dump_argv), dump_argv);
+	}
+	if (timeout)
+		fprintf(stderr, "scan finished after %u.%03u seconds\n",
+			elapsed / 1000, elapsed % 1000);
+
+	for (i = 0; i < scan_multi.n_bss; i++) {
+		print_bss(scan_multi.bss[i].attrs, scan_multi.bss[i].len,
+			  &scan_params);
+		free(scan_multi.bss[i].attrs);
+	}
+	free(scan_multi.bss);
+
+ out_events:
+	nl80211_cleanup(&evstate);
+ out:
+	free(trig_argv);
+	free(opt_argv);
+	ifcache_free(&ifc);
+	memset(&scan_multi, 0, sizeof(scan_multi));
+	return err;
+}
+
+static const struct cmd *scan_multi_cmd;
+static const struct cmd *scan_history_cmd;
+
+static const struct cmd *select_scan_toplevel_cmd(int argc, char **argv)
+{
+	if (argc && !strcmp(argv[0], "history"))
+		return scan_history_cmd;
+	return scan_multi_cmd;
+}
+
+__ACMD(NULL, scan, "scan", "[--all|<devname>*] [-u|-b] [--timeout <seconds>] [freq <freq>*] [<scan options>]",
+       0, 0, 0, CIB_NONE, handle_scan_multi,
+       "Scan with several devices at the same time (or all of them with\n"
+       "--all), giving each radio a share of the channels it supports, and\n"
+       "print the combined results. Without frequencies, all channels any\n"
+       "of the devices supports are scanned. The other scan options are as\n"
+       "for \"dev <devname> scan\" and apply to every device.",
+       select_scan_toplevel_cmd, scan_multi_cmd,
+       .formats = true);
+
+struct scan_history_bss {
+	const __u8 *bssid;	/* points into the store, one per BSS */
+	const __u8 *ssid;
+	__u8 ssid_len;
+	__u32 first, last;
+	unsigned int count;
+	int min_signal, max_signal;
+	long long sum_signal;
+	__u16 freq;
+};
+
+static struct {
+	const char *ssid;
+	bool summary;
+	int n_bss, size;
+	struct scan_history_bss *bss;
+} scan_history;
+
+static void print_history_time(__u32 t)
+{
+	char buf[32];
+	time_t tt = t;
+
+	strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&tt));
+	printf("%s", buf);
+}
+
+static void history_entry(const struct bss_store_entry *e, void *priv)
+{
+	struct scan_history_bss *b;
+	char mac_addr[20];
+	int i, size;
+
+	if (scan_history.ssid &&
+	    (strlen(scan_history.ssid) != e->ssid_len ||
+	     memcmp(scan_history.ssid, e->ssid, e->ssid_len)))
+		return;
+
+	if (!scan_history.summary) {
+		if (iw_format != IW_FORMAT_TEXT) {
+			fmt_obj_begin(NULL);
+			fmt_uint("time", e->time);
+			fmt_mac("bssid", e->bssid);
+			fmt_ssid("ssid", e->ssid, e->ssid_len);
+			fmt_uint("freq", e->freq);
+			fmt_int("signal", e->signal);
+			fmt_obj_end();
+			return;
+		}
+		mac_addr_n2a(mac_addr, (unsigned char *)e->bssid);
+		print_history_time(e->time);
+		printf(" %s %5u %4d dBm ", mac_addr, e->freq, e->signal);
+		print_ssid_escaped(e->ssid_len, e->ssid);
+		printf("\n");
+		return;
+	}
+
+	for (i = 0; i < scan_history.n_bss; i++)
+		if (scan_history.bss[i].bssid == e->bssid)
+			break;
+
+	if (i == scan_history.n_bss) {
+		if (scan_history.n_bss == scan_history.size) {
+			size = scan_history.size ? 2 * scan_history.size : 64;
+			b = realloc(scan_history.bss, size * sizeof(*b));
+			if (!b)
+				return;
+			scan_history.bss = b;
+			scan_history.size = size;
+		}
+		b = &scan_history.bss[scan_history.n_bss++];
+		memset(b, 0, sizeof(*b));
+		b->bssid = e->bssid;
+		b->ssid = e->ssid;
+		b->ssid_len = e->ssid_len;
+		b->first = e->time;
+		b->min_signal = e->signal;
+		b->max_signal = e->signal;
+	} else
+		b = &scan_history.bss[i];
+
+	b->last = e->time;
+	b->freq = e->freq;
+	b->count++;
+	b->sum_signal += e->signal;
+	if (e->signal < b->min_signal)
+		b->min_signal = e->signal;
+	if (e->signal > b->max_signal)
+		b->max_signal = e->signal;
+}
+
+static void print_history_summary(void)
+{
+	struct scan_history_bss *b;
+	char mac_addr[20];
+	int i;
+
+	for (i = 0; i < scan_history.n_bss; i++) {
+		b = &scan_history.bss[i];
+		if (iw_format != IW_FORMAT_TEXT) {
+			fmt_obj_begin(NULL);
+			fmt_mac("bssid", b->bssid);
+			fmt_ssid("ssid", b->ssid, b->ssid_len);
+			fmt_uint("freq", b->freq);
+			fmt_uint("first_seen", b->first);
+			fmt_uint("last_seen", b->last);
+			fmt_uint("sightings", b->count);
+			fmt_int("signal_min", b->min_signal);
+			fmt_int("signal_avg", b->sum_signal / b->count);
+			fmt_int("signal_max", b->max_signal);
+			fmt_obj_end();
+			continue;
+		}
+		mac_addr_n2a(mac_addr, (unsigned char *)b->bssid);
+		printf("%s ", mac_addr);
+		print_ssid_escaped(b->ssid_len, b->ssid);
+		printf("\n\tfreq: %u\n\tfirst seen: ", b->freq);
+		print_history_time(b->first);
+		printf("\n\tlast seen: ");
+		print_history_time(b->last);
+		printf("\n\tsightings: %u\n", b->count);
+		printf("\tsignal: %d/%lld/%d dBm (min/avg/max)\n",
+		       b->min_signal, b->sum_signal / b->count, b->max_signal);
+	}
+}
+
+/*
+ * A point in time: seconds since the epoch, or with a suffix of
+ * s, m, h or d that long before now.
+ */
+static int parse_history_time(const char *arg, __u32 *t)
+{
+	unsigned long val;
+	char *end;
+
+	val = strtoul(arg, &end, 10);
+	if (end == arg)
+		return 1;
+
+	switch (*end) {
+	case '\0':
+		*t = val;
+		return 0;
+	case 'd':
+		val *= 24;
+		/* fall through */
+	case 'h':
+		val *= 60;
+		/* fall through */
+	case 'm':
+		val *= 60;
+		/* fall through */
+	case 's':
+		if (end[1])
+			return 1;
+		*t = time(NULL) - val;
 		return 0;
 	}
 
-	dump_argv[0] = argv[0];
-	return handle_cmd(state, id, dump_argc, dump_argv);
+	return 1;
 }
-TOPLEVEL(scan, "[-u] [freq <freq>*] [ies <hex as 00:11:..>] [meshid <meshid>] [lowpri,flush,ap-force] [randomise[=<addr>/<mask>]] [ssid <ssid>*|passive]", 0, 0,
-	 CIB_NETDEV, handle_scan_combined,
-	 "Scan on the given frequencies and probe for the given SSIDs\n"
-	 "(or wildcard if not given) unless passive scanning is requested.\n"
-	 "If -u is specified print unknown data in the scan results.\n"
-	 "Specified (vendor) IEs must be well-formed.");
-COMMAND(scan, dump, "[-u]",
-	NL80211_CMD_GET_SCAN, NLM_F_DUMP, CIB_NETDEV, handle_scan_dump,
-	"Dump the current scan results. If -u is specified, print unknown\n"
-	"data in scan results.");
-COMMAND(scan, trigger, "[freq <freq>*] [ies <hex as 00:11:..>] [meshid <meshid>] [lowpri,flush,ap-force] [randomise[=<addr>/<mask>]] [ssid <ssid>*|passive]",
-	NL80211_CMD_TRIGGER_SCAN, 0, CIB_NETDEV, handle_scan,
-	 "Trigger a scan on the given frequencies with probing for the given\n"
-	 "SSIDs (or wildcard if not given) unless passive scanning is requested.");
+
+static int handle_scan_history(struct nl80211_state *state,
+			       struct nl_cb *cb,
+			       struct nl_msg *msg,
+			       int argc, char **argv,
+			       enum id_input id)
+{
+	struct bss_store st;
+	unsigned char bssid[ETH_ALEN];
+	bool have_bssid = false;
+	__u32 from = 0, to = UINT_MAX;
+	const char *path;
+	int err;
+
+	/* strip "scan history" */
+	argc -= 2;
+	argv += 2;
+
+	if (!argc)
+		return 1;
+	path = argv[0];
+	argc--;
+	argv++;
+
+	memset(&scan_history, 0, sizeof(scan_history));
+
+	for (; argc; argc--, argv++) {
+		if (!strcmp(argv[0], "--summary")) {
+			scan_history.summary = true;
+			continue;
+		}
+		if (argc < 2)
+			return 1;
+		if (!strcmp(argv[0], "--bssid")) {
+			if (mac_addr_a2n(bssid, argv[1]))
+				return 1;
+			have_bssid = true;
+		} else if (!strcmp(argv[0], "--ssid")) {
+			scan_history.ssid = argv[1];
+		} else if (!strcmp(argv[0], "--from")) {
+			if (parse_history_time(argv[1], &from))
+				return 1;
+		} else if (!strcmp(argv[0], "--to")) {
+			if (parse_history_time(argv[1], &to))
+				return 1;
+		} else
+			return 1;
+		argc--;
+		argv++;
+	}
+
+	err = bss_store_open(&st, path, false);
+	if (err) {
+		fprintf(stderr, "%s: %s\n", path, strerror(-err));
+		return err;
+	}
+
+	err = bss_store_query(&st, have_bssid ? bssid : NULL, from, to,
+			      history_entry, NULL);
+	if (!err && scan_history.summary)
+		print_history_summary();
+
+	/* the entries point into the mapping */
+	bss_store_close(&st);
+	free(scan_history.bss);
+	memset(&scan_history, 0, sizeof(scan_history));
+	return err;
+}
+__ACMD(NULL, scan, "scan", "history <file> [--bssid <addr>] [--ssid <ssid>] [--from <time>] [--to <time>] [--summary]",
+       0, 0, 0, CIB_NONE, handle_scan_history,
+       "Show the sightings recorded in a BSS store by \"scan --store\" or\n"
+       "\"scan dump --store\", optionally only those of one BSS or SSID and\n"
+       "within a time range. Times are seconds since the epoch or, with a\n"
+       "suffix of s, m, h or d, that long ago. --summary prints one entry\n"
+       "per BSS with first and last sighting and signal statistics.",
+       select_scan_toplevel_cmd, scan_history_cmd,
+       .formats = true);
@@ -1,6 +1,8 @@
 #include <net/if.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 #include <netlink/genl/genl.h>
 #include <netlink/genl/family.h>
@@ -43,10 +45,34 @@ static void print_power_mode(struct nlattr *a)
 	}
 }
 
-void parse_bitrate(struct nlattr *bitrate_attr, char *buf, int buflen)
+/*
+ * Byte counters, from the 64 bit attribute where the kernel sends it;
+ * the 32 bit one wraps every 4 GiB. Returns the width of the counter
+ * that was found, 0 if there is none.
+ */
+int sta_bytes(struct nlattr **sinfo, bool tx, __u64 *bytes)
+{
+	int attr64 = tx ? NL80211_STA_INFO_TX_BYTES64 : NL80211_STA_INFO_RX_BYTES64;
+	int attr32 = tx ? NL80211_STA_INFO_TX_BYTES : NL80211_STA_INFO_RX_BYTES;
+
+	if (sinfo[attr64] && nla_len(sinfo[attr64]) >= 8) {
+		*bytes = nla_get_u64(sinfo[attr64]);
+		return 64;
+	}
+	if (sinfo[attr32] && nla_len(sinfo[attr32]) >= 4) {
+		*bytes = nla_get_u32(sinfo[attr32]);
+		return 32;
+	}
+	return 0;
+}
+
+/*
+ * Decode a bitrate attribute; the fields the kernel didn't send stay
+ * at 0, or -1 for the MCS indexes. Anything that wants to look at the
+ * MCS, width or guard interval should use this and not the string.
+ */
+int parse_rate_info(struct nlattr *bitrate_attr, struct rate_info *ri)
 {
-	int rate = 0;
-	char *pos = buf;
 	struct nlattr *rinfo[NL80211_RATE_INFO_MAX + 1];
 	static struct nla_policy rate_policy[NL80211_RATE_INFO_MAX + 1] = {
 		[NL80211_RATE_INFO_BITRATE] = { .type = NLA_U16 },
@@ -54,41 +80,96 @@ void parse_bitrate(struct nlattr *bitrate_attr, char *buf, int buflen)
 		[NL80211_RATE_INFO_MCS] = { .type = NLA_U8 },
 		[NL80211_RATE_INFO_40_MHZ_WIDTH] = { .type = NLA_FLAG },
 		[NL80211_RATE_INFO_SHORT_GI] = { .type = NLA_FLAG },
+		[NL80211_RATE_INFO_VHT_MCS] = { .type = NLA_U8 },
+		[NL80211_RATE_INFO_VHT_NSS] = { .type = NLA_U8 },
+		[NL80211_RATE_INFO_80_MHZ_WIDTH] = { .type = NLA_FLAG },
+		[NL80211_RATE_INFO_80P80_MHZ_WIDTH] = { .type = NLA_FLAG },
+		[NL80211_RATE_INFO_160_MHZ_WIDTH] = { .type = NLA_FLAG },
 	};
 
+	memset(ri, 0, sizeof(*ri));
+	ri->mcs = -1;
+	ri->vht_mcs = -1;
+
 	if (nla_parse_nested(rinfo, NL80211_RATE_INFO_MAX,
-			     bitrate_attr, rate_policy)) {
-		snprintf(buf, buflen, "failed to parse nested rate attributes!");
-		return;
-	}
+			     bitrate_attr, rate_policy))
+		return -EINVAL;
 
 	if (rinfo[NL80211_RATE_INFO_BITRATE32])
-		rate = nla_get_u32(rinfo[NL80211_RATE_INFO_BITRATE32]);
+		ri->bitrate = nla_get_u32(rinfo[NL80211_RATE_INFO_BITRATE32]);
 	else if (rinfo[NL80211_RATE_INFO_BITRATE])
-		rate = nla_get_u16(rinfo[NL80211_RATE_INFO_BITRATE]);
-	if (rate > 0)
-		pos += snprintf(pos, buflen - (pos - buf),
-				"%d.%d MBit/s", rate / 10, rate % 10);
+		ri->bitrate = nla_get_u16(rinfo[NL80211_RATE_INFO_BITRATE]);
 
 	if (rinfo[NL80211_RATE_INFO_MCS])
-		pos += snprintf(pos, buflen - (pos - buf),
-				" MCS %d", nla_get_u8(rinfo[NL80211_RATE_INFO_MCS]));
+		ri->mcs = nla_get_u8(rinfo[NL80211_RATE_INFO_MCS]);
 	if (rinfo[NL80211_RATE_INFO_VHT_MCS])
-		pos += snprintf(pos, buflen - (pos - buf),
-				" VHT-MCS %d", nla_get_u8(rinfo[NL80211_RATE_INFO_VHT_MCS]));
-	if (rinfo[NL80211_RATE_INFO_40_MHZ_WIDTH])
-		pos += snprintf(pos, buflen - (pos - buf), " 40MHz");
-	if (rinfo[NL80211_RATE_INFO_80_MHZ_WIDTH])
-		pos += snprintf(pos, buflen - (pos - buf), " 80MHz");
-	if (rinfo[NL80211_RATE_INFO_80P80_MHZ_WIDTH])
-		pos += snprintf(pos, buflen - (pos - buf), " 80P80MHz");
+		ri->vht_mcs = nla_get_u8(rinfo[NL80211_RATE_INFO_VHT_MCS]);
+	if (rinfo[NL80211_RATE_INFO_VHT_NSS])
+		ri->vht_nss = nla_get_u8(rinfo[NL80211_RATE_INFO_VHT_NSS]);
+
 	if (rinfo[NL80211_RATE_INFO_160_MHZ_WIDTH])
-		pos += snprintf(pos, buflen - (pos - buf), " 160MHz");
-	if (rinfo[NL80211_RATE_INFO_SHORT_GI])
+		ri->width = RATE_WIDTH_160;
+	else if (rinfo[NL80211_RATE_INFO_80P80_MHZ_WIDTH])
+		ri->width = RATE_WIDTH_80P80;
+	else if (rinfo[NL80211_RATE_INFO_80_MHZ_WIDTH])
+		ri->width = RATE_WIDTH_80;
+	else if (rinfo[NL80211_RATE_INFO_40_MHZ_WIDTH])
+		ri->width = RATE_WIDTH_40;
+
+	ri->short_gi = rinfo[NL80211_RATE_INFO_SHORT_GI];
+	return 0;
+}
+
+const char *rate_width_name(enum rate_width width)
+{
+	switch (width) {
+	case RATE_WIDTH_40:
+		return "40MHz";
+	case RATE_WIDTH_80:
+		return "80MHz";
+	case RATE_WIDTH_80P80:
+		return "80P80MHz";
+	case RATE_WIDTH_160:
+		return "160MHz";
+	default:
+		return NULL;
+	}
+}
+
+void format_rate_info(const struct rate_info *ri, char *buf, int buflen)
+{
+	char *pos = buf;
+
+	*buf = 0;
+
+	if (ri->bitrate)
+		pos += snprintf(pos, buflen - (pos - buf), "%u.%u MBit/s",
+				ri->bitrate / 10, ri->bitrate % 10);
+	if (ri->mcs >= 0)
+		pos += snprintf(pos, buflen - (pos - buf), " MCS %d", ri->mcs);
+	if (ri->vht_mcs >= 0)
+		pos += snprintf(pos, buflen - (pos - buf),
+				" VHT-MCS %d", ri->vht_mcs);
+	if (ri->width != RATE_WIDTH_NONE)
+		pos += snprintf(pos, buflen - (pos - buf), " %s",
+				rate_width_name(ri->width));
+	if (ri->short_gi)
 		pos += snprintf(pos, buflen - (pos - buf), " short GI");
-	if (rinfo[NL80211_RATE_INFO_VHT_NSS])
+	if (ri->vht_nss)
 		pos += snprintf(pos, buflen - (pos - buf),
-				" VHT-NSS %d", nla_get_u8(rinfo[NL80211_RATE_INFO_VHT_NSS]));
+				" VHT-NSS %d", ri->vht_nss);
+}
+
+void parse_bitrate(struct nlattr *bitrate_attr, char *buf, int buflen)
+{
+	struct rate_info ri;
+
+	if (parse_rate_info(bitrate_attr, &ri)) {
+		snprintf(buf, buflen, "failed to parse nested rate attributes!");
+		return;
+	}
+
+	format_rate_info(&ri, buf, buflen);
 }
 
 static char *get_chain_signal(struct nlattr *attr_list)
@@ -118,17 +199,431 @@ static char *get_chain_signal(struct nlattr *attr_list)
 	return buf;
 }
 
+static const struct {
+	enum nl80211_sta_flags flag;
+	const char *name;
+} sta_flag_names[] = {
+	{ NL80211_STA_FLAG_AUTHORIZED, "authorized" },
+	{ NL80211_STA_FLAG_AUTHENTICATED, "authenticated" },
+	{ NL80211_STA_FLAG_SHORT_PREAMBLE, "short_preamble" },
+	{ NL80211_STA_FLAG_WME, "wme" },
+	{ NL80211_STA_FLAG_MFP, "mfp" },
+	{ NL80211_STA_FLAG_TDLS_PEER, "tdls_peer" },
+};
+
+/*
+ * Filters for "station dump": an AP may have hundreds of stations, so
+ * the filters are applied to the parsed attributes and only stations
+ * that match are formatted. The MAC addresses go into a hash set.
+ */
+enum sta_field {
+	STA_FIELD_INACTIVE,
+	STA_FIELD_RX_BYTES,
+	STA_FIELD_RX_PACKETS,
+	STA_FIELD_TX_BYTES,
+	STA_FIELD_TX_PACKETS,
+	STA_FIELD_TX_RETRIES,
+	STA_FIELD_TX_FAILED,
+	STA_FIELD_SIGNAL,
+	STA_FIELD_SIGNAL_AVG,
+	STA_FIELD_T_OFFSET,
+	STA_FIELD_TX_BITRATE,
+	STA_FIELD_RX_BITRATE,
+	STA_FIELD_THROUGHPUT,
+	STA_FIELD_MESH,
+	STA_FIELD_FLAGS,
+};
+
+static const char *sta_field_names[] = {
+	[STA_FIELD_INACTIVE] = "inactive",
+	[STA_FIELD_RX_BYTES] = "rx_bytes",
+	[STA_FIELD_RX_PACKETS] = "rx_packets",
+	[STA_FIELD_TX_BYTES] = "tx_bytes",
+	[STA_FIELD_TX_PACKETS] = "tx_packets",
+	[STA_FIELD_TX_RETRIES] = "tx_retries",
+	[STA_FIELD_TX_FAILED] = "tx_failed",
+	[STA_FIELD_SIGNAL] = "signal",
+	[STA_FIELD_SIGNAL_AVG] = "signal_avg",
+	[STA_FIELD_T_OFFSET] = "t_offset",
+	[STA_FIELD_TX_BITRATE] = "tx_bitrate",
+	[STA_FIELD_RX_BITRATE] = "rx_bitrate",
+	[STA_FIELD_THROUGHPUT] = "expected_throughput",
+	[STA_FIELD_MESH] = "mesh",
+	[STA_FIELD_FLAGS] = "flags",
+};
+
+struct sta_mac_slot {
+	unsigned char mac[ETH_ALEN];
+	bool used;
+};
+
+struct sta_filter {
+	struct sta_mac_slot *macs;
+	unsigned int mac_size, n_macs;	/* mac_size is a power of two */
+	bool have_inactive, have_signal;
+	__u32 min_inactive;		/* ms */
+	int max_signal;			/* dBm */
+	__u32 flags_mask, flags_set;
+	__u32 fields;			/* BIT(STA_FIELD_*), 0 for all */
+};
+
+static struct sta_filter sta_filter;
+
+static struct sta_mac_slot *sta_mac_find(struct sta_filter *f,
+					 const unsigned char *mac)
+{
+	unsigned int mask = f->mac_size - 1;
+	__u32 x = (mac[0] << 8 | mac[1]) ^
+		  ((__u32)mac[2] << 24 | mac[3] << 16 | mac[4] << 8 | mac[5]);
+	/*
+	 * Multiplicative hashing: the low bits of the product only depend
+	 * on the low bits of x, so the bucket comes from the high ones.
+	 */
+	unsigned int i = x * 2654435761U >> (32 - __builtin_ctz(f->mac_size));
+
+	while (f->macs[i].used && memcmp(f->macs[i].mac, mac, ETH_ALEN))
+		i = (i + 1) & mask;
+
+	return &f->macs[i];
+}
+
+static int sta_mac_add(void *priv, const unsigned char *mac)
+{
+	struct sta_filter *f = priv;
+	struct sta_mac_slot *old = f->macs, *slot;
+	unsigned int old_size = f->mac_size, i;
+
+	/* keep the table at most half full */
+	if (2 * (f->n_macs + 1) > f->mac_size) {
+		f->mac_size = old_size ? 2 * old_size : 64;
+		f->macs = calloc(f->mac_size, sizeof(*f->macs));
+		if (!f->macs) {
+			f->macs = old;
+			f->mac_size = old_size;
+			return -ENOMEM;
+		}
+		for (i = 0; i < old_size; i++)
+			if (old[i].used)
+				*sta_mac_find(f, old[i].mac) = old[i];
+		free(old);
+	}
+
+	slot = sta_mac_find(f, mac);
+	if (!slot->used) {
+		memcpy(slot->mac, mac, ETH_ALEN);
+		slot->used = true;
+		f->n_macs++;
+	}
+	return 0;
+}
+
+/* comma separated MAC addresses */
+static int parse_mac_list(char *list,
+			  int (*add)(void *priv, const unsigned char *mac),
+			  void *priv)
+{
+	unsigned char mac[ETH_ALEN];
+	char *tok, *next;
+	int err;
+
+	for (tok = list; tok; tok = next) {
+		next = strchr(tok, ',');
+		if (next)
+			*next++ = 0;
+		if (!*tok)
+			continue;
+		if (mac_addr_a2n(mac, tok)) {
+			fprintf(stderr, "invalid mac address\n");
+			return 2;
+		}
+		err = add(priv, mac);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+/*
+ * One or more MAC addresses per line, '#' starts a comment; "-" is
+ * standard input.
+ */
+static int read_mac_file(const char *path,
+			 int (*add)(void *priv, const unsigned char *mac),
+			 void *priv)
+{
+	char line[256], *tok, *hash;
+	FILE *file;
+	int err = 0;
+
+	if (strcmp(path, "-") == 0)
+		file = stdin;
+	else
+		file = fopen(path, "r");
+	if (!file) {
+		err = -errno;
+		fprintf(stderr, "%s: %s\n", path, strerror(-err));
+		return 2;
+	}
+
+	while (!err && fgets(line, sizeof(line), file)) {
+		hash = strchr(line, '#');
+		if (hash)
+			*hash = 0;
+		for (tok = strtok(line, " \t\r\n"); tok && !err;
+		     tok = strtok(NULL, " \t\r\n"))
+			err = parse_mac_list(tok, add, priv);
+	}
+
+	if (file != stdin)
+		fclose(file);
+	return err;
+}
+
+static int parse_sta_flags(struct sta_filter *f, char *list)
+{
+	char *tok, *next;
+	bool set;
+	int i;
+
+	for (tok = list; tok; tok = next) {
+		next = strchr(tok, ',');
+		if (next)
+			*next++ = 0;
+		set = *tok != '!';
+		if (!set)
+			tok++;
+		for (i = 0; i < ARRAY_SIZE(sta_flag_names); i++)
+			if (!strcmp(tok, sta_flag_names[i].name))
+				break;
+		if (i == ARRAY_SIZE(sta_flag_names))
+			return 1;
+		f->flags_mask |= BIT(sta_flag_names[i].flag);
+		if (set)
+			f->flags_set |= BIT(sta_flag_names[i].flag);
+	}
+	return 0;
+}
+
+static int parse_sta_fields(struct sta_filter *f, char *list)
+{
+	char *tok, *next;
+	int i;
+
+	for (tok = list; tok; tok = next) {
+		next = strchr(tok, ',');
+		if (next)
+			*next++ = 0;
+		for (i = 0; i < ARRAY_SIZE(sta_field_names); i++)
+			if (!strcmp(tok, sta_field_names[i]))
+				break;
+		if (i == ARRAY_SIZE(sta_field_names))
+			return 1;
+		f->fields |= BIT(i);
+	}
+	return 0;
+}
+
+static int parse_sta_filter(struct sta_filter *f, int argc, char **argv)
+{
+	char *end;
+	int err;
+
+	while (argc) {
+		if (argc < 2)
+			return 1;
+		if (!strcmp(argv[0], "--mac")) {
+			if (argv[1][0] == '@')
+				err = read_mac_file(argv[1] + 1, sta_mac_add, f);
+			else
+				err = parse_mac_list(argv[1], sta_mac_add, f);
+			if (err)
+				return err;
+		} else if (!strcmp(argv[0], "--min-inactive")) {
+			f->min_inactive = strtoul(argv[1], &end, 10);
+			if (*end)
+				return 1;
+			f->have_inactive = true;
+		} else if (!strcmp(argv[0], "--max-signal")) {
+			f->max_signal = strtol(argv[1], &end, 10);
+			if (*end)
+				return 1;
+			f->have_signal = true;
+		} else if (!strcmp(argv[0], "--flags")) {
+			if (parse_sta_flags(f, argv[1]))
+				return 1;
+		} else if (!strcmp(argv[0], "--fields")) {
+			if (parse_sta_fields(f, argv[1]))
+				return 1;
+		} else
+			return 1;
+		argc -= 2;
+		argv += 2;
+	}
+
+	return 0;
+}
+
+/* the MAC address is checked before the station info is even parsed */
+static bool sta_filter_mac(struct sta_filter *f, struct nlattr **tb)
+{
+	if (!f || !f->n_macs)
+		return true;
+	return tb[NL80211_ATTR_MAC] &&
+	       sta_mac_find(f, nla_data(tb[NL80211_ATTR_MAC]))->used;
+}
+
+static bool sta_filter_match(struct sta_filter *f, struct nlattr **sinfo)
+{
+	struct nl80211_sta_flag_update *sta_flags;
+	struct nlattr *a;
+
+	if (!f)
+		return true;
+
+	if (f->have_inactive) {
+		a = sinfo[NL80211_STA_INFO_INACTIVE_TIME];
+		if (!a || nla_get_u32(a) < f->min_inactive)
+			return false;
+	}
+
+	if (f->have_signal) {
+		a = sinfo[NL80211_STA_INFO_SIGNAL];
+		if (!a || (int8_t)nla_get_u8(a) > f->max_signal)
+			return false;
+	}
+
+	if (f->flags_mask) {
+		a = sinfo[NL80211_STA_INFO_STA_FLAGS];
+		if (!a || nla_len(a) < sizeof(*sta_flags))
+			return false;
+		sta_flags = nla_data(a);
+		/* a flag the kernel didn't report doesn't match either way */
+		if ((sta_flags->mask & f->flags_mask) != f->flags_mask ||
+		    (sta_flags->set & f->flags_mask) != f->flags_set)
+			return false;
+	}
+
+	return true;
+}
+
+static bool sta_field(struct sta_filter *f, enum sta_field field)
+{
+	return !f || !f->fields || (f->fields & BIT(field));
+}
+
+/* the string as in the text output, and the decoded fields */
+static void fmt_rate_info(const char *str_key, const char *key,
+			  const struct rate_info *ri)
+{
+	char buf[100];
+
+	format_rate_info(ri, buf, sizeof(buf));
+	fmt_str(str_key, buf);
+
+	fmt_obj_begin(key);
+	if (ri->bitrate)
+		fmt_uint("kbps", ri->bitrate * 100ULL);
+	if (ri->mcs >= 0)
+		fmt_uint("mcs", ri->mcs);
+	if (ri->vht_mcs >= 0)
+		fmt_uint("vht_mcs", ri->vht_mcs);
+	if (ri->vht_nss)
+		fmt_uint("vht_nss", ri->vht_nss);
+	if (ri->width != RATE_WIDTH_NONE)
+		fmt_str("width", rate_width_name(ri->width));
+	fmt_bool("short_gi", ri->short_gi);
+	fmt_obj_end();
+}
+
+static void print_sta_fmt(struct sta_filter *f, struct nlattr **tb,
+			  struct nlattr **sinfo)
+{
+	struct nl80211_sta_flag_update *sta_flags;
+	struct rate_info ri;
+	__u64 bytes;
+	int i;
+
+	fmt_obj_begin(NULL);
+	fmt_mac("mac", nla_data(tb[NL80211_ATTR_MAC]));
+	fmt_str("ifname", iw_ifname(nla_get_u32(tb[NL80211_ATTR_IFINDEX])));
+
+	if (sinfo[NL80211_STA_INFO_INACTIVE_TIME] &&
+	    sta_field(f, STA_FIELD_INACTIVE))
+		fmt_uint("inactive_ms",
+			 nla_get_u32(sinfo[NL80211_STA_INFO_INACTIVE_TIME]));
+	if (sta_field(f, STA_FIELD_RX_BYTES) && sta_bytes(sinfo, false, &bytes))
+		fmt_uint("rx_bytes", bytes);
+	if (sinfo[NL80211_STA_INFO_RX_PACKETS] &&
+	    sta_field(f, STA_FIELD_RX_PACKETS))
+		fmt_uint("rx_packets",
+			 nla_get_u32(sinfo[NL80211_STA_INFO_RX_PACKETS]));
+	if (sta_field(f, STA_FIELD_TX_BYTES) && sta_bytes(sinfo, true, &bytes))
+		fmt_uint("tx_bytes", bytes);
+	if (sinfo[NL80211_STA_INFO_TX_PACKETS] &&
+	    sta_field(f, STA_FIELD_TX_PACKETS))
+		fmt_uint("tx_packets",
+			 nla_get_u32(sinfo[NL80211_STA_INFO_TX_PACKETS]));
+	if (sinfo[NL80211_STA_INFO_TX_RETRIES] &&
+	    sta_field(f, STA_FIELD_TX_RETRIES))
+		fmt_uint("tx_retries",
+			 nla_get_u32(sinfo[NL80211_STA_INFO_TX_RETRIES]));
+	if (sinfo[NL80211_STA_INFO_TX_FAILED] &&
+	    sta_field(f, STA_FIELD_TX_FAILED))
+		fmt_uint("tx_failed",
+			 nla_get_u32(sinfo[NL80211_STA_INFO_TX_FAILED]));
+	if (sinfo[NL80211_STA_INFO_SIGNAL] && sta_field(f, STA_FIELD_SIGNAL))
+		fmt_int("signal",
+			(int8_t)nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL]));
+	if (sinfo[NL80211_STA_INFO_SIGNAL_AVG] &&
+	    sta_field(f, STA_FIELD_SIGNAL_AVG))
+		fmt_int("signal_avg",
+			(int8_t)nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL_AVG]));
+	if (sinfo[NL80211_STA_INFO_T_OFFSET] &&
+	    sta_field(f, STA_FIELD_T_OFFSET))
+		fmt_int("t_offset_us",
+			(long long)nla_get_u64(sinfo[NL80211_STA_INFO_T_OFFSET]));
+	if (sinfo[NL80211_STA_INFO_TX_BITRATE] &&
+	    sta_field(f, STA_FIELD_TX_BITRATE) &&
+	    !parse_rate_info(sinfo[NL80211_STA_INFO_TX_BITRATE], &ri))
+		fmt_rate_info("tx_bitrate", "tx_rate", &ri);
+	if (sinfo[NL80211_STA_INFO_RX_BITRATE] &&
+	    sta_field(f, STA_FIELD_RX_BITRATE) &&
+	    !parse_rate_info(sinfo[NL80211_STA_INFO_RX_BITRATE], &ri))
+		fmt_rate_info("rx_bitrate", "rx_rate", &ri);
+	if (sinfo[NL80211_STA_INFO_EXPECTED_THROUGHPUT] &&
+	    sta_field(f, STA_FIELD_THROUGHPUT))
+		fmt_uint("expected_throughput_kbps",
+			 nla_get_u32(sinfo[NL80211_STA_INFO_EXPECTED_THROUGHPUT]));
+
+	if (sinfo[NL80211_STA_INFO_STA_FLAGS] && sta_field(f, STA_FIELD_FLAGS)) {
+		sta_flags = (struct nl80211_sta_flag_update *)
+			    nla_data(sinfo[NL80211_STA_INFO_STA_FLAGS]);
+
+		for (i = 0; i < ARRAY_SIZE(sta_flag_names); i++)
+			if (sta_flags->mask & BIT(sta_flag_names[i].flag))
+				fmt_bool(sta_flag_names[i].name,
+					 sta_flags->set &
+					 BIT(sta_flag_names[i].flag));
+	}
+	fmt_obj_end();
+}
+
 static int print_sta_handler(struct nl_msg *msg, void *arg)
 {
 	struct nlattr *tb[NL80211_ATTR_MAX + 1];
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct nlattr *sinfo[NL80211_STA_INFO_MAX + 1];
-	char mac_addr[20], state_name[10], dev[20];
+	char mac_addr[20], state_name[10];
+	const char *dev;
 	struct nl80211_sta_flag_update *sta_flags;
+	struct sta_filter *f = arg;
+	__u64 bytes;
 	static struct nla_policy stats_policy[NL80211_STA_INFO_MAX + 1] = {
 		[NL80211_STA_INFO_INACTIVE_TIME] = { .type = NLA_U32 },
 		[NL80211_STA_INFO_RX_BYTES] = { .type = NLA_U32 },
 		[NL80211_STA_INFO_TX_BYTES] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_RX_BYTES64] = { .type = NLA_U64 },
+		[NL80211_STA_INFO_TX_BYTES64] = { .type = NLA_U64 },
 		[NL80211_STA_INFO_RX_PACKETS] = { .type = NLA_U32 },
 		[NL80211_STA_INFO_TX_PACKETS] = { .type = NLA_U32 },
 		[NL80211_STA_INFO_SIGNAL] = { .type = NLA_U8 },
@@ -159,6 +654,9 @@ static int print_sta_handler(struct nl_msg *msg, void *arg)
 	 * the kernel starts sending station notifications.
 	 */
 
+	if (!sta_filter_mac(f, tb))
+		return NL_SKIP;
+
 	if (!tb[NL80211_ATTR_STA_INFO]) {
 		fprintf(stderr, "sta stats missing!\n");
 		return NL_SKIP;
@@ -170,63 +668,79 @@ static int print_sta_handler(struct nl_msg *msg, void *arg)
 		return NL_SKIP;
 	}
 
+	if (!sta_filter_match(f, sinfo))
+		return NL_SKIP;
+
+	if (iw_format != IW_FORMAT_TEXT) {
+		print_sta_fmt(f, tb, sinfo);
+		return NL_SKIP;
+	}
+
 	mac_addr_n2a(mac_addr, nla_data(tb[NL80211_ATTR_MAC]));
-	if_indextoname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]), dev);
+	dev = iw_ifname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]));
 	printf("Station %s (on %s)", mac_addr, dev);
 
-	if (sinfo[NL80211_STA_INFO_INACTIVE_TIME])
+	if (sinfo[NL80211_STA_INFO_INACTIVE_TIME] &&
+	    sta_field(f, STA_FIELD_INACTIVE))
 		printf("\n\tinactive time:\t%u ms",
 			nla_get_u32(sinfo[NL80211_STA_INFO_INACTIVE_TIME]));
-	if (sinfo[NL80211_STA_INFO_RX_BYTES])
-		printf("\n\trx bytes:\t%u",
-			nla_get_u32(sinfo[NL80211_STA_INFO_RX_BYTES]));
-	if (sinfo[NL80211_STA_INFO_RX_PACKETS])
+	if (sta_field(f, STA_FIELD_RX_BYTES) && sta_bytes(sinfo, false, &bytes))
+		printf("\n\trx bytes:\t%llu", (unsigned long long)bytes);
+	if (sinfo[NL80211_STA_INFO_RX_PACKETS] &&
+	    sta_field(f, STA_FIELD_RX_PACKETS))
 		printf("\n\trx packets:\t%u",
 			nla_get_u32(sinfo[NL80211_STA_INFO_RX_PACKETS]));
-	if (sinfo[NL80211_STA_INFO_TX_BYTES])
-		printf("\n\ttx bytes:\t%u",
-			nla_get_u32(sinfo[NL80211_STA_INFO_TX_BYTES]));
-	if (sinfo[NL80211_STA_INFO_TX_PACKETS])
+	if (sta_field(f, STA_FIELD_TX_BYTES) && sta_bytes(sinfo, true, &bytes))
+		printf("\n\ttx bytes:\t%llu", (unsigned long long)bytes);
+	if (sinfo[NL80211_STA_INFO_TX_PACKETS] &&
+	    sta_field(f, STA_FIELD_TX_PACKETS))
 		printf("\n\ttx packets:\t%u",
 			nla_get_u32(sinfo[NL80211_STA_INFO_TX_PACKETS]));
-	if (sinfo[NL80211_STA_INFO_TX_RETRIES])
+	if (sinfo[NL80211_STA_INFO_TX_RETRIES] &&
+	    sta_field(f, STA_FIELD_TX_RETRIES))
 		printf("\n\ttx retries:\t%u",
 			nla_get_u32(sinfo[NL80211_STA_INFO_TX_RETRIES]));
-	if (sinfo[NL80211_STA_INFO_TX_FAILED])
+	if (sinfo[NL80211_STA_INFO_TX_FAILED] &&
+	    sta_field(f, STA_FIELD_TX_FAILED))
 		printf("\n\ttx failed:\t%u",
 			nla_get_u32(sinfo[NL80211_STA_INFO_TX_FAILED]));
 
 	chain = get_chain_signal(sinfo[NL80211_STA_INFO_CHAIN_SIGNAL]);
-	if (sinfo[NL80211_STA_INFO_SIGNAL])
+	if (sinfo[NL80211_STA_INFO_SIGNAL] && sta_field(f, STA_FIELD_SIGNAL))
 		printf("\n\tsignal:  \t%d %sdBm",
 			(int8_t)nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL]),
 			chain);
 
 	chain = get_chain_signal(sinfo[NL80211_STA_INFO_CHAIN_SIGNAL_AVG]);
-	if (sinfo[NL80211_STA_INFO_SIGNAL_AVG])
+	if (sinfo[NL80211_STA_INFO_SIGNAL_AVG] &&
+	    sta_field(f, STA_FIELD_SIGNAL_AVG))
 		printf("\n\tsignal avg:\t%d %sdBm",
 			(int8_t)nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL_AVG]),
 			chain);
 
-	if (sinfo[NL80211_STA_INFO_T_OFFSET])
+	if (sinfo[NL80211_STA_INFO_T_OFFSET] &&
+	    sta_field(f, STA_FIELD_T_OFFSET))
 		printf("\n\tToffset:\t%lld us",
 			(unsigned long long)nla_get_u64(sinfo[NL80211_STA_INFO_T_OFFSET]));
 
-	if (sinfo[NL80211_STA_INFO_TX_BITRATE]) {
+	if (sinfo[NL80211_STA_INFO_TX_BITRATE] &&
+	    sta_field(f, STA_FIELD_TX_BITRATE)) {
 		char buf[100];
 
 		parse_bitrate(sinfo[NL80211_STA_INFO_TX_BITRATE], buf, sizeof(buf));
 		printf("\n\ttx bitrate:\t%s", buf);
 	}
 
-	if (sinfo[NL80211_STA_INFO_RX_BITRATE]) {
+	if (sinfo[NL80211_STA_INFO_RX_BITRATE] &&
+	    sta_field(f, STA_FIELD_RX_BITRATE)) {
 		char buf[100];
 
 		parse_bitrate(sinfo[NL80211_STA_INFO_RX_BITRATE], buf, sizeof(buf));
 		printf("\n\trx bitrate:\t%s", buf);
 	}
 
-	if (sinfo[NL80211_STA_INFO_EXPECTED_THROUGHPUT]) {
+	if (sinfo[NL80211_STA_INFO_EXPECTED_THROUGHPUT] &&
+	    sta_field(f, STA_FIELD_THROUGHPUT)) {
 		uint32_t thr;
 
 		thr = nla_get_u32(sinfo[NL80211_STA_INFO_EXPECTED_THROUGHPUT]);
@@ -237,13 +751,16 @@ static int print_sta_handler(struct nl_msg *msg, void *arg)
 		       thr / 1000, thr % 1000);
 	}
 
-	if (sinfo[NL80211_STA_INFO_LLID])
+	if (sinfo[NL80211_STA_INFO_LLID] &&
+	    sta_field(f, STA_FIELD_MESH))
 		printf("\n\tmesh llid:\t%d",
 			nla_get_u16(sinfo[NL80211_STA_INFO_LLID]));
-	if (sinfo[NL80211_STA_INFO_PLID])
+	if (sinfo[NL80211_STA_INFO_PLID] &&
+	    sta_field(f, STA_FIELD_MESH))
 		printf("\n\tmesh plid:\t%d",
 			nla_get_u16(sinfo[NL80211_STA_INFO_PLID]));
-	if (sinfo[NL80211_STA_INFO_PLINK_STATE]) {
+	if (sinfo[NL80211_STA_INFO_PLINK_STATE] &&
+	    sta_field(f, STA_FIELD_MESH)) {
 		switch (nla_get_u8(sinfo[NL80211_STA_INFO_PLINK_STATE])) {
 		case LISTEN:
 			strcpy(state_name, "LISTEN");
@@ -272,20 +789,23 @@ static int print_sta_handler(struct nl_msg *msg, void *arg)
 		}
 		printf("\n\tmesh plink:\t%s", state_name);
 	}
-	if (sinfo[NL80211_STA_INFO_LOCAL_PM]) {
+	if (sinfo[NL80211_STA_INFO_LOCAL_PM] &&
+	    sta_field(f, STA_FIELD_MESH)) {
 		printf("\n\tmesh local PS mode:\t");
 		print_power_mode(sinfo[NL80211_STA_INFO_LOCAL_PM]);
 	}
-	if (sinfo[NL80211_STA_INFO_PEER_PM]) {
+	if (sinfo[NL80211_STA_INFO_PEER_PM] &&
+	    sta_field(f, STA_FIELD_MESH)) {
 		printf("\n\tmesh peer PS mode:\t");
 		print_power_mode(sinfo[NL80211_STA_INFO_PEER_PM]);
 	}
-	if (sinfo[NL80211_STA_INFO_NONPEER_PM]) {
+	if (sinfo[NL80211_STA_INFO_NONPEER_PM] &&
+	    sta_field(f, STA_FIELD_MESH)) {
 		printf("\n\tmesh non-peer PS mode:\t");
 		print_power_mode(sinfo[NL80211_STA_INFO_NONPEER_PM]);
 	}
 
-	if (sinfo[NL80211_STA_INFO_STA_FLAGS]) {
+	if (sinfo[NL80211_STA_INFO_STA_FLAGS] && sta_field(f, STA_FIELD_FLAGS)) {
 		sta_flags = (struct nl80211_sta_flag_update *)
 			    nla_data(sinfo[NL80211_STA_INFO_STA_FLAGS]);
 
@@ -372,12 +892,328 @@ static int handle_station_get(struct nl80211_state *state,
  nla_put_failure:
 	return -ENOBUFS;
 }
-COMMAND(station, get, "<MAC address>",
+
+/*
+ * "station get|del --from <file>": all the requests go out on the one
+ * socket without waiting for each reply, up to a window of them at a
+ * time. Replies and acks are matched to their request by the sequence
+ * number, in any order, and reported in the order of the file at the
+ * end.
+ *
+ * The kernel handles each request within the send and queues its reply
+ * and ack right away, so the window has to fit into the receive buffer
+ * or replies get dropped. That buffer is raised for the purpose, and
+ * the window sized from what the kernel actually granted (it caps the
+ * size at net.core.rmem_max).
+ */
+#define STA_BULK_WINDOW		64
+/* receive buffer use of one reply (at most a page) and its ack */
+#define STA_BULK_REQ_SPACE	6144
+
+struct sta_req {
+	unsigned char mac[ETH_ALEN];
+	__u32 seq;
+	bool done;
+	int err;
+	struct nl_msg *reply;
+};
+
+struct sta_bulk {
+	struct sta_req *req;
+	int n_req, size;
+	int n_sent, pending;
+};
+
+static int sta_bulk_add(void *priv, const unsigned char *mac)
+{
+	struct sta_bulk *bulk = priv;
+	struct sta_req *req;
+	int size;
+
+	if (bulk->n_req == bulk->size) {
+		size = bulk->size ? 2 * bulk->size : 64;
+		req = realloc(bulk->req, size * sizeof(*req));
+		if (!req)
+			return -ENOMEM;
+		bulk->req = req;
+		bulk->size = size;
+	}
+
+	req = &bulk->req[bulk->n_req++];
+	memset(req, 0, sizeof(*req));
+	memcpy(req->mac, mac, ETH_ALEN);
+	return 0;
+}
+
+static struct sta_req *sta_bulk_find(struct sta_bulk *bulk, __u32 seq)
+{
+	__u32 i;
+
+	if (!bulk->n_sent)
+		return NULL;
+
+	/* sequence numbers are handed out one after the other */
+	i = seq - bulk->req[0].seq;
+	if (i >= bulk->n_sent || bulk->req[i].seq != seq)
+		return NULL;
+	return &bulk->req[i];
+}
+
+static void sta_bulk_done(struct sta_bulk *bulk, __u32 seq, int err)
+{
+	struct sta_req *req = sta_bulk_find(bulk, seq);
+
+	if (!req || req->done)
+		return;
+	req->done = true;
+	req->err = err;
+	bulk->pending--;
+}
+
+static int sta_bulk_no_seq_check(struct nl_msg *msg, void *arg)
+{
+	return NL_OK;
+}
+
+static int sta_bulk_reply_handler(struct nl_msg *msg, void *arg)
+{
+	struct sta_req *req = sta_bulk_find(arg, nlmsg_hdr(msg)->nlmsg_seq);
+
+	if (req && !req->reply) {
+		nlmsg_get(msg);
+		req->reply = msg;
+	}
+	return NL_SKIP;
+}
+
+static int sta_bulk_ack_handler(struct nl_msg *msg, void *arg)
+{
+	sta_bulk_done(arg, nlmsg_hdr(msg)->nlmsg_seq, 0);
+	return NL_SKIP;
+}
+
+static int sta_bulk_error_handler(struct sockaddr_nl *nla,
+				  struct nlmsgerr *err, void *arg)
+{
+	sta_bulk_done(arg, err->msg.nlmsg_seq, err->error);
+	return NL_SKIP;
+}
+
+static int sta_bulk_send(struct nl80211_state *state, struct sta_req *req,
+			 enum nl80211_commands cmd, enum id_input id,
+			 long long devidx)
+{
+	struct nl_msg *msg;
+	int err;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		return -ENOMEM;
+
+	genlmsg_put(msg, 0, 0, state->nl80211_id, 0, 0, cmd, 0);
+	if (id == II_WDEV)
+		NLA_PUT_U64(msg, NL80211_ATTR_WDEV, devidx);
+	else
+		NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, devidx);
+	NLA_PUT(msg, NL80211_ATTR_MAC, ETH_ALEN, req->mac);
+
+	/* this asks for an ack, so a reply or an error always comes back */
+	err = nl_send_auto_complete(state->nl_sock, msg);
+	if (err < 0) {
+		fprintf(stderr, "failed to send: %s\n", nl_geterror(err));
+		nlmsg_free(msg);
+		return -ECOMM;
+	}
+
+	req->seq = nlmsg_hdr(msg)->nlmsg_seq;
+	nlmsg_free(msg);
+	return 0;
+ nla_put_failure:
+	nlmsg_free(msg);
+	return -ENOBUFS;
+}
+
+static void sta_bulk_report(struct sta_req *req, bool del)
+{
+	char mac_addr[20];
+
+	if (!req->err && !del) {
+		if (req->reply)
+			print_sta_handler(req->reply, NULL);
+		return;
+	}
+
+	if (iw_format != IW_FORMAT_TEXT) {
+		fmt_obj_begin(NULL);
+		fmt_mac("mac", req->mac);
+		fmt_int("error", req->err);
+		fmt_obj_end();
+		return;
+	}
+
+	mac_addr_n2a(mac_addr, req->mac);
+	if (req->err)
+		printf("Station %s: %s (%d)\n", mac_addr, strerror(-req->err),
+		       req->err);
+	else
+		printf("Station %s: deleted\n", mac_addr);
+}
+
+static int sta_bulk_window(struct nl80211_state *state)
+{
+	int fd = nl_socket_get_fd(state->nl_sock), size = 0;
+	socklen_t len = sizeof(size);
+
+	nl_socket_set_buffer_size(state->nl_sock,
+				  STA_BULK_WINDOW * STA_BULK_REQ_SPACE, 8192);
+	if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len))
+		return 1;
+
+	size /= STA_BULK_REQ_SPACE;
+	if (size < 1)
+		return 1;
+	if (size > STA_BULK_WINDOW)
+		return STA_BULK_WINDOW;
+	return size;
+}
+
+static int handle_station_bulk(struct nl80211_state *state,
+			       struct nl_cb *cb,
+			       struct nl_msg *msg,
+			       int argc, char **argv,
+			       enum id_input id)
+{
+	struct sta_bulk bulk;
+	enum nl80211_commands cmd;
+	long long devidx;
+	bool del;
+	char *end;
+	int err, send_err = 0, i, window, failed = 0;
+
+	/* "wlan0 station get --from <file>" */
+	if (argc != 5 || strcmp(argv[3], "--from"))
+		return 1;
+	del = strcmp(argv[2], "del") == 0;
+	cmd = del ? NL80211_CMD_DEL_STATION : NL80211_CMD_GET_STATION;
+
+	switch (id) {
+	case II_NETDEV:
+		devidx = if_nametoindex(argv[0]);
+		if (!devidx)
+			return -errno;
+		break;
+	case II_WDEV:
+		devidx = strtoll(argv[0], &end, 0);
+		if (*end)
+			return 1;
+		break;
+	default:
+		return 1;
+	}
+
+	memset(&bulk, 0, sizeof(bulk));
+	err = read_mac_file(argv[4], sta_bulk_add, &bulk);
+	if (err || !bulk.n_req)
+		goto out_free;
+
+	cb = nl_cb_alloc(iw_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
+	if (!cb) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+	nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM,
+		  sta_bulk_no_seq_check, NULL);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, sta_bulk_reply_handler, &bulk);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, sta_bulk_ack_handler, &bulk);
+	nl_cb_err(cb, NL_CB_CUSTOM, sta_bulk_error_handler, &bulk);
+
+	window = sta_bulk_window(state);
+
+	/*
+	 * After a failed send, stop sending but still collect the answers
+	 * to what was sent, so every station gets reported.
+	 */
+	while ((!send_err && bulk.n_sent < bulk.n_req) || bulk.pending) {
+		while (!send_err && bulk.n_sent < bulk.n_req &&
+		       bulk.pending < window) {
+			send_err = sta_bulk_send(state, &bulk.req[bulk.n_sent],
+						 cmd, id, devidx);
+			if (send_err)
+				break;
+			bulk.n_sent++;
+			bulk.pending++;
+		}
+		if (!bulk.pending)
+			break;
+
+		err = nl_recvmsgs(state->nl_sock, cb);
+		if (err < 0) {
+			fprintf(stderr, "failed to receive: %s\n",
+				nl_geterror(err));
+			err = 2;
+			goto out;
+		}
+	}
+
+	for (i = bulk.n_sent; i < bulk.n_req; i++)
+		bulk.req[i].err = send_err;
+
+	for (i = 0; i < bulk.n_req; i++) {
+		sta_bulk_report(&bulk.req[i], del);
+		if (bulk.req[i].err)
+			failed++;
+	}
+	err = failed ? 2 : 0;
+ out:
+	nl_cb_put(cb);
+ out_free:
+	for (i = 0; i < bulk.n_req; i++)
+		if (bulk.req[i].reply)
+			nlmsg_free(bulk.req[i].reply);
+	free(bulk.req);
+	return err;
+}
+
+static const struct cmd *station_get_cmd;
+static const struct cmd *station_get_from_cmd;
+static const struct cmd *station_del_cmd;
+static const struct cmd *station_del_from_cmd;
+
+static const struct cmd *select_station_get_cmd(int argc, char **argv)
+{
+	if (argc && strcmp(argv[0], "--from") == 0)
+		return station_get_from_cmd;
+	return station_get_cmd;
+}
+
+static const struct cmd *select_station_del_cmd(int argc, char **argv)
+{
+	if (argc && strcmp(argv[0], "--from") == 0)
+		return station_del_from_cmd;
+	return station_del_cmd;
+}
+
+COMMAND_ALIAS(station, get, "<MAC address>",
 	NL80211_CMD_GET_STATION, 0, CIB_NETDEV, handle_station_get,
-	"Get information for a specific station.");
-COMMAND(station, del, "<MAC address>",
+	"Get information for a specific station.",
+	select_station_get_cmd, station_get_cmd,
+	.formats = true);
+COMMAND_ALIAS(station, get, "--from <file|->",
+	0, 0, CIB_NETDEV, handle_station_bulk,
+	"Get information for all the stations listed in the file, one or\n"
+	"more MAC addresses per line.",
+	select_station_get_cmd, station_get_from_cmd,
+	.formats = true);
+COMMAND_ALIAS(station, del, "<MAC address>",
 	NL80211_CMD_DEL_STATION, 0, CIB_NETDEV, handle_station_get,
-	"Remove the given station entry (use with caution!)");
+	"Remove the given station entry (use with caution!)",
+	select_station_del_cmd, station_del_cmd);
+COMMAND_ALIAS(station, del, "--from <file|->",
+	0, 0, CIB_NETDEV, handle_station_bulk,
+	"Remove all the stations listed in the file, one or more MAC\n"
+	"addresses per line (use with caution!)",
+	select_station_del_cmd, station_del_from_cmd,
+	.formats = true);
 
 static const struct cmd *station_set_plink;
 static const struct cmd *station_set_vlan;
@@ -547,15 +1383,624 @@ COMMAND_ALIAS(station, set, "<MAC address> mesh_power_mode "
 	"Set link-specific mesh power mode for this station",
 	select_station_cmd, station_set_mesh_power_mode);
 
+/*
+ * Interval mode of "station dump": the counters of every station are
+ * kept from one sample to the next, and the differences printed.
+ */
+struct sta_sample {
+	unsigned char mac[ETH_ALEN];
+	__u32 ifindex;
+	__u64 rx_bytes, tx_bytes;
+	int rx_width, tx_width;		/* of the byte counters, see sta_bytes() */
+	__u32 rx_packets, tx_packets;
+	__u32 tx_retries, tx_failed;
+	unsigned int generation;
+};
+
+static struct {
+	int n_sta, size;
+	struct sta_sample *sta;
+	unsigned int generation;
+	unsigned int interval;		/* ms since the last sample */
+} sta_samples;
+
+static unsigned long long sta_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static __u32 sta_counter(struct nlattr **sinfo, int attr)
+{
+	return sinfo[attr] ? nla_get_u32(sinfo[attr]) : 0;
+}
+
+/*
+ * A 32 bit counter that went backwards has wrapped, the unsigned
+ * arithmetic takes care of that. A 64 bit one won't wrap, so it was
+ * reset (the driver was reloaded, say); count from zero then.
+ */
+static __u64 sta_bytes_delta(__u64 old, __u64 cur, int width)
+{
+	if (width == 32)
+		return (__u32)(cur - old);
+	return cur >= old ? cur - old : cur;
+}
+
+/* in units of 0.1% */
+static unsigned int sta_ratio(__u32 part, __u32 total)
+{
+	return total ? (unsigned long long)part * 1000 / total : 0;
+}
+
+static void print_sta_delta(struct sta_sample *old, struct sta_sample *cur)
+{
+	__u64 rx_bytes = sta_bytes_delta(old->rx_bytes, cur->rx_bytes,
+					 cur->rx_width);
+	__u64 tx_bytes = sta_bytes_delta(old->tx_bytes, cur->tx_bytes,
+					 cur->tx_width);
+	/* unsigned arithmetic takes care of counters that wrapped */
+	__u32 rx_packets = cur->rx_packets - old->rx_packets;
+	__u32 tx_packets = cur->tx_packets - old->tx_packets;
+	__u32 tx_retries = cur->tx_retries - old->tx_retries;
+	__u32 tx_failed = cur->tx_failed - old->tx_failed;
+	unsigned int ms = sta_samples.interval ? sta_samples.interval : 1;
+	unsigned long long rx_bps = rx_bytes * 8000 / ms;
+	unsigned long long tx_bps = tx_bytes * 8000 / ms;
+	unsigned int retry = sta_ratio(tx_retries, tx_packets);
+	unsigned int fail = sta_ratio(tx_failed, tx_packets + tx_failed);
+	char mac_addr[20];
+
+	if (iw_format != IW_FORMAT_TEXT) {
+		fmt_obj_begin(NULL);
+		fmt_mac("mac", cur->mac);
+		fmt_str("dev", iw_ifname(cur->ifindex));
+		fmt_uint("interval_ms", ms);
+		fmt_uint("rx_bps", rx_bps);
+		fmt_uint("tx_bps", tx_bps);
+		fmt_uint("rx_pps", rx_packets * 1000ULL / ms);
+		fmt_uint("tx_pps", tx_packets * 1000ULL / ms);
+		fmt_uint("tx_packets", tx_packets);
+		fmt_uint("tx_retries", tx_retries);
+		fmt_uint("tx_failed", tx_failed);
+		fmt_obj_end();
+		return;
+	}
+
+	mac_addr_n2a(mac_addr, cur->mac);
+	printf("%s (on %s): rx %llu.%03llu Mbit/s %llu pps, tx %llu.%03llu Mbit/s %llu pps, "
+	       "retries %u.%u%%, failed %u.%u%%\n",
+	       mac_addr, iw_ifname(cur->ifindex),
+	       rx_bps / 1000000, rx_bps / 1000 % 1000,
+	       rx_packets * 1000ULL / ms,
+	       tx_bps / 1000000, tx_bps / 1000 % 1000,
+	       tx_packets * 1000ULL / ms,
+	       retry / 10, retry % 10, fail / 10, fail % 10);
+}
+
+static int sample_sta_handler(struct nl_msg *msg, void *arg)
+{
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *sinfo[NL80211_STA_INFO_MAX + 1];
+	struct sta_sample cur, *sta;
+	int i, size;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_STA_INFO] || !tb[NL80211_ATTR_MAC] ||
+	    !tb[NL80211_ATTR_IFINDEX] || !sta_filter_mac(&sta_filter, tb) ||
+	    nla_parse_nested(sinfo, NL80211_STA_INFO_MAX,
+			     tb[NL80211_ATTR_STA_INFO], NULL) ||
+	    !sta_filter_match(&sta_filter, sinfo))
+		return NL_SKIP;
+
+	memset(&cur, 0, sizeof(cur));
+	memcpy(cur.mac, nla_data(tb[NL80211_ATTR_MAC]), ETH_ALEN);
+	cur.ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+	cur.rx_width = sta_bytes(sinfo, false, &cur.rx_bytes);
+	cur.tx_width = sta_bytes(sinfo, true, &cur.tx_bytes);
+	cur.rx_packets = sta_counter(sinfo, NL80211_STA_INFO_RX_PACKETS);
+	cur.tx_packets = sta_counter(sinfo, NL80211_STA_INFO_TX_PACKETS);
+	cur.tx_retries = sta_counter(sinfo, NL80211_STA_INFO_TX_RETRIES);
+	cur.tx_failed = sta_counter(sinfo, NL80211_STA_INFO_TX_FAILED);
+	cur.generation = sta_samples.generation;
+
+	for (i = 0; i < sta_samples.n_sta; i++) {
+		sta = &sta_samples.sta[i];
+		if (sta->ifindex == cur.ifindex &&
+		    !memcmp(sta->mac, cur.mac, ETH_ALEN))
+			break;
+	}
+
+	if (i < sta_samples.n_sta) {
+		/*
+		 * only if it was there in the previous sample, too, and the
+		 * byte counters can be compared
+		 */
+		if (sta->generation + 1 == cur.generation &&
+		    sta->rx_width == cur.rx_width &&
+		    sta->tx_width == cur.tx_width)
+			print_sta_delta(sta, &cur);
+		*sta = cur;
+		return NL_SKIP;
+	}
+
+	if (sta_samples.n_sta == sta_samples.size) {
+		size = sta_samples.size ? 2 * sta_samples.size : 16;
+		sta = realloc(sta_samples.sta, size * sizeof(*sta));
+		if (!sta)
+			return NL_SKIP;
+		sta_samples.sta = sta;
+		sta_samples.size = size;
+	}
+	sta_samples.sta[sta_samples.n_sta++] = cur;
+
+	return NL_SKIP;
+}
+
+static int handle_station_sample(struct nl80211_state *state,
+				 struct nl_cb *cb,
+				 struct nl_msg *msg,
+				 int argc, char **argv,
+				 enum id_input id)
+{
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, sample_sta_handler, NULL);
+	return 0;
+}
+HIDDEN(station, sample, NULL, NL80211_CMD_GET_STATION, NLM_F_DUMP, CIB_NETDEV,
+       handle_station_sample);
+
+static int handle_station_dump_interval(struct nl80211_state *state,
+					struct nl_cb *cb,
+					struct nl_msg *msg,
+					int argc, char **argv,
+					enum id_input id)
+{
+	char *sample_argv[] = { argv[0], "station", "sample" };
+	unsigned long long last = 0, now, next;
+	unsigned int interval = 0;
+	char *end;
+	int err, i, n;
+
+	/* "wlan0 station dump -i <ms>", with the filters in between */
+	for (i = 3; i < argc; i += 2) {
+		if (i + 1 == argc)
+			return 1;
+		if (!strcmp(argv[i], "-i")) {
+			interval = strtoul(argv[i + 1], &end, 10);
+			if (*end)
+				return 1;
+			continue;
+		}
+		err = parse_sta_filter(&sta_filter, 2, argv + i);
+		if (err)
+			return err;
+	}
+	if (!interval || sta_filter.fields)
+		return 1;
+
+	memset(&sta_samples, 0, sizeof(sta_samples));
+
+	/* the same socket is used for every sample */
+	for (next = sta_now(); ; next += interval) {
+		now = sta_now();
+		if (next > now)
+			usleep((next - now) * 1000);
+		else
+			next = now;
+
+		now = sta_now();
+		sta_samples.interval = last ? now - last : 0;
+		last = now;
+		sta_samples.generation++;
+
+		err = handle_cmd(state, id, ARRAY_SIZE(sample_argv),
+				 sample_argv);
+		if (err)
+			break;
+
+		/* forget the stations that are gone */
+		for (i = 0, n = 0; i < sta_samples.n_sta; i++)
+			if (sta_samples.sta[i].generation ==
+			    sta_samples.generation)
+				sta_samples.sta[n++] = sta_samples.sta[i];
+		sta_samples.n_sta = n;
+
+		/*
+		 * This never ends, so every interval (but the first, which
+		 * has nothing to compare with) is a document of its own.
+		 */
+		if (iw_format != IW_FORMAT_TEXT && sta_samples.interval)
+			fmt_finish(true);
+		fflush(stdout);
+	}
+
+	free(sta_samples.sta);
+	memset(&sta_samples, 0, sizeof(sta_samples));
+	free(sta_filter.macs);
+	memset(&sta_filter, 0, sizeof(sta_filter));
+	return err;
+}
+
 static int handle_station_dump(struct nl80211_state *state,
 			       struct nl_cb *cb,
 			       struct nl_msg *msg,
 			       int argc, char **argv,
 			       enum id_input id)
 {
-	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, print_sta_handler, NULL);
+	int err;
+
+	err = parse_sta_filter(&sta_filter, argc, argv);
+	if (err)
+		return err;
+
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, print_sta_handler,
+		  &sta_filter);
 	return 0;
 }
-COMMAND(station, dump, NULL,
+
+static const struct cmd *station_dump_cmd;
+static const struct cmd *station_dump_interval_cmd;
+
+static const struct cmd *select_station_dump_cmd(int argc, char **argv)
+{
+	int i;
+
+	for (i = 0; i < argc; i++)
+		if (!strcmp(argv[i], "-i"))
+			return station_dump_interval_cmd;
+	return station_dump_cmd;
+}
+
+COMMAND_ALIAS(station, dump,
+	"[--mac <MAC>[,<MAC>]*|@<file>] [--min-inactive <ms>] "
+	"[--max-signal <dBm>] [--flags <flags>] [--fields <fields>]",
 	NL80211_CMD_GET_STATION, NLM_F_DUMP, CIB_NETDEV, handle_station_dump,
-	"List all stations known, e.g. the AP on managed interfaces");
+	"List all stations known, e.g. the AP on managed interfaces.\n"
+	"Only list the given stations (--mac may be repeated, a file holds\n"
+	"MAC addresses separated by white space), the ones inactive for at\n"
+	"least <ms>, the ones at or below <dBm>, or the ones with (or with\n"
+	"'!', without) the given comma separated flags: authorized,\n"
+	"authenticated, short_preamble, wme, mfp, tdls_peer.\n"
+	"--fields only prints the given fields: inactive, rx_bytes,\n"
+	"rx_packets, tx_bytes, tx_packets, tx_retries, tx_failed, signal,\n"
+	"signal_avg, t_offset, tx_bitrate, rx_bitrate, expected_throughput,\n"
+	"mesh, flags.",
+	select_station_dump_cmd, station_dump_cmd,
+	.formats = true);
+COMMAND_ALIAS(station, dump, "-i <ms> [--mac ...] [--min-inactive <ms>] ...",
+	0, 0, CIB_NETDEV, handle_station_dump_interval,
+	"Sample the station counters every <ms> milliseconds and print\n"
+	"each station's throughput, packet rate, retry ratio and failure\n"
+	"ratio over the interval. The filters are those of the plain dump,\n"
+	"except --fields. With --format, every interval is a document.",
+	select_station_dump_cmd, station_dump_interval_cmd,
+	.formats = true);
+
+/*
+ * "station stats": the distribution of a few values over all the
+ * stations of a dump, instead of every station's block. The values
+ * are kept and sorted at the end, which gives exact percentiles and
+ * the histogram buckets in one pass.
+ */
+enum sta_stat_hist {
+	STA_HIST_LINEAR,	/* buckets of ->width */
+	STA_HIST_LOG2,		/* bucket n counts [2^n, 2^(n+1)) */
+};
+
+struct sta_stat {
+	const char *label, *unit;	/* text output */
+	const char *key;		/* structured output, raw values */
+	enum sta_stat_hist hist;
+	int width;
+	int scale;			/* raw values per unit */
+	long long *val;
+	int n, size;
+};
+
+enum sta_stat_id {
+	STA_STAT_SIGNAL,
+	STA_STAT_CHAIN_SIGNAL,
+	STA_STAT_TX_BITRATE,
+	STA_STAT_RX_BITRATE,
+	STA_STAT_THROUGHPUT,
+	STA_STAT_INACTIVE,
+	__STA_STAT_NUM,
+};
+
+static struct {
+	struct sta_stat stat[__STA_STAT_NUM];
+	int n_sta;
+	int flags_known[ARRAY_SIZE(sta_flag_names)];
+	int flags_set[ARRAY_SIZE(sta_flag_names)];
+} sta_stats = {
+	.stat = {
+		[STA_STAT_SIGNAL] = { "signal", "dBm", "signal_dbm",
+				      STA_HIST_LINEAR, 5, 1 },
+		[STA_STAT_CHAIN_SIGNAL] = { "chain signal", "dBm",
+					    "chain_signal_dbm",
+					    STA_HIST_LINEAR, 5, 1 },
+		[STA_STAT_TX_BITRATE] = { "tx bitrate", "Mbit/s",
+					  "tx_bitrate_kbps",
+					  STA_HIST_LOG2, 0, 1000 },
+		[STA_STAT_RX_BITRATE] = { "rx bitrate", "Mbit/s",
+					  "rx_bitrate_kbps",
+					  STA_HIST_LOG2, 0, 1000 },
+		[STA_STAT_THROUGHPUT] = { "expected throughput", "Mbit/s",
+					  "expected_throughput_kbps",
+					  STA_HIST_LOG2, 0, 1000 },
+		[STA_STAT_INACTIVE] = { "inactive", "ms", "inactive_ms",
+					STA_HIST_LOG2, 0, 1 },
+	},
+};
+
+static void sta_stat_add(enum sta_stat_id id, long long val)
+{
+	struct sta_stat *s = &sta_stats.stat[id];
+	long long *tmp;
+	int size;
+
+	if (s->n == s->size) {
+		size = s->size ? 2 * s->size : 64;
+		tmp = realloc(s->val, size * sizeof(*tmp));
+		if (!tmp)
+			return;
+		s->val = tmp;
+		s->size = size;
+	}
+	s->val[s->n++] = val;
+}
+
+static int stats_sta_handler(struct nl_msg *msg, void *arg)
+{
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *sinfo[NL80211_STA_INFO_MAX + 1];
+	struct nl80211_sta_flag_update *sta_flags;
+	static struct nla_policy stats_policy[NL80211_STA_INFO_MAX + 1] = {
+		[NL80211_STA_INFO_INACTIVE_TIME] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_SIGNAL] = { .type = NLA_U8 },
+		[NL80211_STA_INFO_CHAIN_SIGNAL] = { .type = NLA_NESTED },
+		[NL80211_STA_INFO_TX_BITRATE] = { .type = NLA_NESTED },
+		[NL80211_STA_INFO_RX_BITRATE] = { .type = NLA_NESTED },
+		[NL80211_STA_INFO_EXPECTED_THROUGHPUT] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_STA_FLAGS] =
+			{ .minlen = sizeof(struct nl80211_sta_flag_update) },
+	};
+	struct rate_info ri;
+	struct nlattr *attr;
+	int i, rem;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[NL80211_ATTR_STA_INFO] || !sta_filter_mac(&sta_filter, tb) ||
+	    nla_parse_nested(sinfo, NL80211_STA_INFO_MAX,
+			     tb[NL80211_ATTR_STA_INFO], stats_policy) ||
+	    !sta_filter_match(&sta_filter, sinfo))
+		return NL_SKIP;
+
+	sta_stats.n_sta++;
+
+	if (sinfo[NL80211_STA_INFO_SIGNAL])
+		sta_stat_add(STA_STAT_SIGNAL,
+			     (int8_t)nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL]));
+	if (sinfo[NL80211_STA_INFO_CHAIN_SIGNAL])
+		nla_for_each_nested(attr, sinfo[NL80211_STA_INFO_CHAIN_SIGNAL],
+				    rem)
+			sta_stat_add(STA_STAT_CHAIN_SIGNAL,
+				     (int8_t)nla_get_u8(attr));
+
+	if (sinfo[NL80211_STA_INFO_TX_BITRATE] &&
+	    !parse_rate_info(sinfo[NL80211_STA_INFO_TX_BITRATE], &ri) &&
+	    ri.bitrate)
+		sta_stat_add(STA_STAT_TX_BITRATE, ri.bitrate * 100LL);
+	if (sinfo[NL80211_STA_INFO_RX_BITRATE] &&
+	    !parse_rate_info(sinfo[NL80211_STA_INFO_RX_BITRATE], &ri) &&
+	    ri.bitrate)
+		sta_stat_add(STA_STAT_RX_BITRATE, ri.bitrate * 100LL);
+	if (sinfo[NL80211_STA_INFO_EXPECTED_THROUGHPUT])
+		sta_stat_add(STA_STAT_THROUGHPUT,
+			     nla_get_u32(sinfo[NL80211_STA_INFO_EXPECTED_THROUGHPUT]));
+
+	if (sinfo[NL80211_STA_INFO_INACTIVE_TIME])
+		sta_stat_add(STA_STAT_INACTIVE,
+			     nla_get_u32(sinfo[NL80211_STA_INFO_INACTIVE_TIME]));
+
+	if (sinfo[NL80211_STA_INFO_STA_FLAGS]) {
+		sta_flags = nla_data(sinfo[NL80211_STA_INFO_STA_FLAGS]);
+		for (i = 0; i < ARRAY_SIZE(sta_flag_names); i++) {
+			if (!(sta_flags->mask & BIT(sta_flag_names[i].flag)))
+				continue;
+			sta_stats.flags_known[i]++;
+			if (sta_flags->set & BIT(sta_flag_names[i].flag))
+				sta_stats.flags_set[i]++;
+		}
+	}
+
+	return NL_SKIP;
+}
+
+static int handle_station_collect(struct nl80211_state *state,
+				  struct nl_cb *cb,
+				  struct nl_msg *msg,
+				  int argc, char **argv,
+				  enum id_input id)
+{
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, stats_sta_handler, NULL);
+	return 0;
+}
+HIDDEN(station, collect, NULL, NL80211_CMD_GET_STATION, NLM_F_DUMP,
+       CIB_NETDEV, handle_station_collect);
+
+static int cmp_stat_val(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* the lower end of the histogram bucket, in units */
+static long long sta_stat_bucket(struct sta_stat *s, long long val)
+{
+	long long units = val / s->scale;
+
+	if (s->hist == STA_HIST_LOG2)
+		return units > 0 ? 1LL << (63 - __builtin_clzll(units)) : 0;
+	/* round towards minus infinity for the signal */
+	if (units < 0)
+		return -((-units + s->width - 1) / s->width) * s->width;
+	return units / s->width * s->width;
+}
+
+static char *sta_stat_str(struct sta_stat *s, long long val,
+			  char *buf, size_t len)
+{
+	if (s->scale == 1)
+		snprintf(buf, len, "%lld", val);
+	else
+		snprintf(buf, len, "%lld.%lld", val / s->scale,
+			 val % s->scale * 10 / s->scale);
+	return buf;
+}
+
+/* nearest rank, the values are sorted */
+static long long sta_stat_pct(struct sta_stat *s, int pct)
+{
+	int rank = (pct * s->n + 99) / 100;
+
+	return s->val[rank ? rank - 1 : 0];
+}
+
+static void print_sta_stat(struct sta_stat *s)
+{
+	static const int pcts[] = { 10, 50, 90 };
+	char label[40], buf[48];
+	long long bucket;
+	int i, n;
+
+	qsort(s->val, s->n, sizeof(*s->val), cmp_stat_val);
+
+	if (iw_format != IW_FORMAT_TEXT) {
+		fmt_obj_begin(NULL);
+		fmt_str("name", s->key);
+		fmt_uint("count", s->n);
+		fmt_int("min", s->val[0]);
+		for (i = 0; i < ARRAY_SIZE(pcts); i++) {
+			sprintf(buf, "p%d", pcts[i]);
+			fmt_int(buf, sta_stat_pct(s, pcts[i]));
+		}
+		fmt_int("max", s->val[s->n - 1]);
+		fmt_arr_begin("histogram");
+		for (i = 0; i < s->n; i += n) {
+			bucket = sta_stat_bucket(s, s->val[i]);
+			for (n = 1; i + n < s->n &&
+				    sta_stat_bucket(s, s->val[i + n]) == bucket; n++)
+				;
+			fmt_obj_begin(NULL);
+			fmt_int("from", bucket * s->scale);
+			fmt_uint("count", n);
+			fmt_obj_end();
+		}
+		fmt_arr_end();
+		fmt_obj_end();
+		return;
+	}
+
+	snprintf(label, sizeof(label), "%s (%s)", s->label, s->unit);
+	printf("%-28s %6d", label, s->n);
+	printf(" %8s", sta_stat_str(s, s->val[0], buf, sizeof(buf)));
+	for (i = 0; i < ARRAY_SIZE(pcts); i++)
+		printf(" %8s", sta_stat_str(s, sta_stat_pct(s, pcts[i]),
+					     buf, sizeof(buf)));
+	printf(" %8s\n\t",
+	       sta_stat_str(s, s->val[s->n - 1], buf, sizeof(buf)));
+
+	for (i = 0; i < s->n; i += n) {
+		bucket = sta_stat_bucket(s, s->val[i]);
+		for (n = 1; i + n < s->n &&
+			    sta_stat_bucket(s, s->val[i + n]) == bucket; n++)
+			;
+		printf(" %lld:%d", bucket, n);
+	}
+	printf("\n");
+}
+
+static void print_sta_stats(void)
+{
+	unsigned int ratio;
+	int i;
+
+	if (iw_format != IW_FORMAT_TEXT) {
+		fmt_obj_begin(NULL);
+		fmt_str("name", "stations");
+		fmt_uint("count", sta_stats.n_sta);
+		for (i = 0; i < ARRAY_SIZE(sta_flag_names); i++)
+			if (sta_stats.flags_known[i])
+				fmt_uint(sta_flag_names[i].name,
+					 sta_stats.flags_set[i]);
+		fmt_obj_end();
+	} else {
+		printf("%d stations", sta_stats.n_sta);
+		for (i = 0; i < ARRAY_SIZE(sta_flag_names); i++) {
+			if (!sta_stats.flags_known[i])
+				continue;
+			ratio = sta_ratio(sta_stats.flags_set[i],
+					  sta_stats.flags_known[i]);
+			printf(", %s %d (%u.%u%%)", sta_flag_names[i].name,
+			       sta_stats.flags_set[i], ratio / 10, ratio % 10);
+		}
+		printf("\n");
+		if (sta_stats.n_sta)
+			printf("%-28s %6s %8s %8s %8s %8s %8s\n", "", "count",
+			       "min", "p10", "p50", "p90", "max");
+	}
+
+	for (i = 0; i < __STA_STAT_NUM; i++)
+		if (sta_stats.stat[i].n)
+			print_sta_stat(&sta_stats.stat[i]);
+}
+
+static int handle_station_stats(struct nl80211_state *state,
+				struct nl_cb *cb,
+				struct nl_msg *msg,
+				int argc, char **argv,
+				enum id_input id)
+{
+	char *collect_argv[] = { argv[0], "station", "collect" };
+	int err, i;
+
+	/* "wlan0 station stats [filters]" */
+	if (argc < 3)
+		return 1;
+	err = parse_sta_filter(&sta_filter, argc - 3, argv + 3);
+	if (!err && sta_filter.fields)
+		err = 1;
+
+	if (!err)
+		err = handle_cmd(state, id, ARRAY_SIZE(collect_argv),
+				 collect_argv);
+	if (!err)
+		print_sta_stats();
+
+	for (i = 0; i < __STA_STAT_NUM; i++) {
+		free(sta_stats.stat[i].val);
+		sta_stats.stat[i].val = NULL;
+		sta_stats.stat[i].n = sta_stats.stat[i].size = 0;
+	}
+	free(sta_filter.macs);
+	memset(&sta_filter, 0, sizeof(sta_filter));
+	return err;
+}
+COMMAND(station, stats, "[--mac <MAC>[,<MAC>]*|@<file>] [--min-inactive <ms>] "
+	"[--max-signal <dBm>] [--flags <flags>]",
+	0, 0, CIB_NETDEV, handle_station_stats,
+	"Summarize all stations (or those that match the filters of\n"
+	"'station dump'): how many have the station flags set, and the\n"
+	"distribution of signal, chain signal, tx/rx bitrate, expected\n"
+	"throughput and inactive time, as percentiles and histograms.",
+	.formats = true);
@@ -0,0 +1,457 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "iw.h"
+
+/*
+ * Persistent BSS store: an append-only file of 16 byte slots, mapped
+ * into memory. Every BSS gets one record (three slots) when it's first
+ * seen, and every sighting of it one slot that links back to the
+ * previous sighting, with the BSS record pointing at the latest one.
+ * This keeps a sighting at 16 bytes and lets the history of a single
+ * BSS be found without going through the whole file. The BSSID index
+ * itself is only kept in memory and built when the store is opened.
+ *
+ * The data is in host byte order, the file is not meant to be moved
+ * between machines of different endianness.
+ */
+
+#define BSS_STORE_MAGIC		0x49574253	/* "IWBS" */
+#define BSS_STORE_VERSION	1
+#define BSS_STORE_SLOT		16
+#define BSS_STORE_GROW		(256 * 1024)
+
+enum bss_store_kind {
+	BSS_STORE_BSS = 1,
+	BSS_STORE_SEEN,
+};
+
+struct bss_store_hdr {
+	__u32 magic;
+	__u32 version;
+	__u32 n_slots;		/* in use, including the header */
+	__u32 n_bss;
+	__u8 reserved[48];
+};
+
+struct bss_store_bss {
+	__u8 kind;
+	__u8 ssid_len;
+	__u8 bssid[ETH_ALEN];
+	__u32 last;		/* slot of the latest sighting, 0 if none */
+	__u32 reserved;
+	__u8 ssid[32];
+};
+
+struct bss_store_seen {
+	__u8 kind;
+	__s8 signal;		/* dBm */
+	__u16 freq;
+	__u32 bss;		/* slot of the BSS record */
+	__u32 prev;		/* previous sighting of this BSS, 0 if none */
+	__u32 time;		/* seconds since the epoch */
+};
+
+#define HDR_SLOTS	(sizeof(struct bss_store_hdr) / BSS_STORE_SLOT)
+#define BSS_SLOTS	(sizeof(struct bss_store_bss) / BSS_STORE_SLOT)
+
+static void *slot(struct bss_store *st, __u32 idx)
+{
+	return (char *)st->map + (size_t)idx * BSS_STORE_SLOT;
+}
+
+static struct bss_store_hdr *hdr(struct bss_store *st)
+{
+	return st->map;
+}
+
+/*
+ * Multiplicative hashing over the whole BSSID. The bucket comes from
+ * the top bits of the product, its low bits only depend on the low
+ * bits of x.
+ */
+static unsigned int bssid_hash(const unsigned char *bssid, unsigned int size)
+{
+	__u32 x = (bssid[0] << 8 | bssid[1]) ^
+		  ((__u32)bssid[2] << 24 | bssid[3] << 16 | bssid[4] << 8 |
+		   bssid[5]);
+
+	return x * 2654435761U >> (32 - __builtin_ctz(size));
+}
+
+static __u32 *index_find(struct bss_store *st, const unsigned char *bssid)
+{
+	unsigned int mask = st->index_size - 1;
+	unsigned int i = bssid_hash(bssid, st->index_size);
+	struct bss_store_bss *b;
+
+	while (st->index[i]) {
+		b = slot(st, st->index[i]);
+		if (!memcmp(b->bssid, bssid, ETH_ALEN))
+			break;
+		i = (i + 1) & mask;
+	}
+
+	return &st->index[i];
+}
+
+static int index_grow(struct bss_store *st)
+{
+	__u32 *old = st->index, old_size = st->index_size, i;
+	__u32 size = old_size ? 2 * old_size : 256;
+
+	st->index = calloc(size, sizeof(*st->index));
+	if (!st->index) {
+		st->index = old;
+		return -ENOMEM;
+	}
+	st->index_size = size;
+
+	for (i = 0; i < old_size; i++)
+		if (old[i])
+			*index_find(st, ((struct bss_store_bss *)
+					 slot(st, old[i]))->bssid) = old[i];
+	free(old);
+	return 0;
+}
+
+static int index_add(struct bss_store *st, __u32 idx)
+{
+	struct bss_store_bss *b = slot(st, idx);
+	int err;
+
+	/* keep the table at most half full */
+	if (2 * (st->index_used + 1) > st->index_size) {
+		err = index_grow(st);
+		if (err)
+			return err;
+	}
+
+	*index_find(st, b->bssid) = idx;
+	st->index_used++;
+	return 0;
+}
+
+static int store_map(struct bss_store *st, size_t len)
+{
+	void *map;
+
+	if (st->map)
+		munmap(st->map, st->map_len);
+	st->map = NULL;
+
+	map = mmap(NULL, len, st->writable ? PROT_READ | PROT_WRITE : PROT_READ,
+		   MAP_SHARED, st->fd, 0);
+	if (map == MAP_FAILED)
+		return -errno;
+
+	st->map = map;
+	st->map_len = len;
+	return 0;
+}
+
+/* make room for n more slots */
+static int store_reserve(struct bss_store *st, __u32 n)
+{
+	size_t need = ((size_t)hdr(st)->n_slots + n) * BSS_STORE_SLOT;
+	size_t len;
+
+	if (need <= st->map_len)
+		return 0;
+
+	len = (need + BSS_STORE_GROW - 1) / BSS_STORE_GROW * BSS_STORE_GROW;
+	if (ftruncate(st->fd, len))
+		return -errno;
+	return store_map(st, len);
+}
+
+/*
+ * Go through all records of a store just mapped, index the BSSes and
+ * make sure every link in the file points at a record of the right kind
+ * that is there. Links to sightings only ever go back in the file and
+ * stay with one BSS, so the chains can't loop either.
+ */
+static int store_check(struct bss_store *st)
+{
+	__u32 n_slots = hdr(st)->n_slots, idx, i;
+	struct bss_store_seen *s;
+	struct bss_store_bss *b;
+	__u8 *kinds;
+	int err = 0;
+
+	/* the kind of record that starts at each slot, 0 for none */
+	kinds = calloc(n_slots, 1);
+	if (!kinds)
+		return -ENOMEM;
+
+	for (idx = HDR_SLOTS; idx < n_slots; ) {
+		b = slot(st, idx);
+		s = slot(st, idx);
+		if (b->kind == BSS_STORE_BSS) {
+			if (idx + BSS_SLOTS > n_slots ||
+			    b->ssid_len > sizeof(b->ssid)) {
+				err = -EINVAL;
+				goto out;
+			}
+			err = index_add(st, idx);
+			if (err)
+				goto out;
+			kinds[idx] = BSS_STORE_BSS;
+			idx += BSS_SLOTS;
+		} else if (b->kind == BSS_STORE_SEEN) {
+			if (s->bss >= idx || kinds[s->bss] != BSS_STORE_BSS ||
+			    (s->prev &&
+			     (s->prev >= idx || kinds[s->prev] != BSS_STORE_SEEN ||
+			      ((struct bss_store_seen *)
+			       slot(st, s->prev))->bss != s->bss))) {
+				err = -EINVAL;
+				goto out;
+			}
+			kinds[idx] = BSS_STORE_SEEN;
+			idx++;
+		} else {
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+	/* the latest sighting of a BSS comes after it, so check it now */
+	for (idx = HDR_SLOTS; idx < n_slots; idx++) {
+		if (kinds[idx] != BSS_STORE_BSS)
+			continue;
+		b = slot(st, idx);
+		i = b->last;
+		if (i && (i >= n_slots || kinds[i] != BSS_STORE_SEEN ||
+			  ((struct bss_store_seen *)slot(st, i))->bss != idx)) {
+			err = -EINVAL;
+			goto out;
+		}
+	}
+ out:
+	free(kinds);
+	return err;
+}
+
+int bss_store_open(struct bss_store *st, const char *path, bool writable)
+{
+	struct bss_store_hdr *h;
+	struct stat sb;
+	int err;
+
+	memset(st, 0, sizeof(*st));
+	st->writable = writable;
+
+	st->fd = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (st->fd < 0)
+		return -errno;
+
+	/* one writer at a time, readers see complete records only */
+	if (flock(st->fd, writable ? LOCK_EX : LOCK_SH)) {
+		err = -errno;
+		goto out;
+	}
+
+	if (fstat(st->fd, &sb)) {
+		err = -errno;
+		goto out;
+	}
+
+	if (sb.st_size == 0) {
+		if (!writable) {
+			err = -ENODATA;
+			goto out;
+		}
+		if (ftruncate(st->fd, BSS_STORE_GROW)) {
+			err = -errno;
+			goto out;
+		}
+		err = store_map(st, BSS_STORE_GROW);
+		if (err)
+			goto out;
+		h = hdr(st);
+		h->magic = BSS_STORE_MAGIC;
+		h->version = BSS_STORE_VERSION;
+		h->n_slots = HDR_SLOTS;
+		return 0;
+	}
+
+	if ((size_t)sb.st_size < sizeof(*h)) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = store_map(st, sb.st_size);
+	if (err)
+		goto out;
+
+	h = hdr(st);
+	if (h->magic != BSS_STORE_MAGIC || h->version != BSS_STORE_VERSION ||
+	    h->n_slots < HDR_SLOTS ||
+	    (size_t)h->n_slots * BSS_STORE_SLOT > st->map_len) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = store_check(st);
+	if (err)
+		goto out;
+
+	return 0;
+ out:
+	bss_store_close(st);
+	return err;
+}
+
+void bss_store_close(struct bss_store *st)
+{
+	if (st->map)
+		munmap(st->map, st->map_len);
+	if (st->fd >= 0)
+		close(st->fd);
+	free(st->index);
+	memset(st, 0, sizeof(*st));
+	st->fd = -1;
+}
+
+int bss_store_add(struct bss_store *st, const unsigned char *bssid,
+		  const __u8 *ssid, __u8 ssid_len,
+		  __u32 time, __u16 freq, int signal)
+{
+	struct bss_store_bss *b;
+	struct bss_store_seen *s;
+	__u32 *entry, idx;
+	int err;
+
+	if (!st->writable)
+		return -EBADF;
+	if (ssid_len > sizeof(b->ssid))
+		ssid_len = sizeof(b->ssid);
+
+	/* room for a new BSS and the sighting, so the mapping stays put */
+	err = store_reserve(st, BSS_SLOTS + 1);
+	if (err)
+		return err;
+
+	entry = st->index_size ? index_find(st, bssid) : NULL;
+	if (!entry || !*entry) {
+		idx = hdr(st)->n_slots;
+		b = slot(st, idx);
+		memset(b, 0, sizeof(*b));
+		b->kind = BSS_STORE_BSS;
+		memcpy(b->bssid, bssid, ETH_ALEN);
+		b->ssid_len = ssid_len;
+		memcpy(b->ssid, ssid, ssid_len);
+		err = index_add(st, idx);
+		if (err)
+			return err;
+		hdr(st)->n_slots += BSS_SLOTS;
+		hdr(st)->n_bss++;
+	} else {
+		idx = *entry;
+		b = slot(st, idx);
+		/* a hidden SSID may be revealed later */
+		if (!b->ssid_len && ssid_len) {
+			memcpy(b->ssid, ssid, ssid_len);
+			b->ssid_len = ssid_len;
+		}
+	}
+
+	/* the same cached entry dumped again isn't a new sighting */
+	if (b->last &&
+	    ((struct bss_store_seen *)slot(st, b->last))->time >= time)
+		return 0;
+
+	s = slot(st, hdr(st)->n_slots);
+	s->kind = BSS_STORE_SEEN;
+	if (signal < -128)
+		signal = -128;
+	else if (signal > 127)
+		signal = 127;
+	s->signal = signal;
+	s->freq = freq;
+	s->bss = idx;
+	s->prev = b->last;
+	s->time = time;
+
+	b->last = hdr(st)->n_slots;
+	hdr(st)->n_slots++;
+	return 0;
+}
+
+static void store_entry(struct bss_store *st, __u32 idx,
+			struct bss_store_entry *e)
+{
+	struct bss_store_seen *s = slot(st, idx);
+	struct bss_store_bss *b = slot(st, s->bss);
+
+	e->time = s->time;
+	e->bssid = b->bssid;
+	e->ssid = b->ssid;
+	e->ssid_len = b->ssid_len;
+	e->freq = s->freq;
+	e->signal = s->signal;
+}
+
+int bss_store_query(struct bss_store *st, const unsigned char *bssid,
+		    __u32 from, __u32 to,
+		    void (*cb)(const struct bss_store_entry *e, void *priv),
+		    void *priv)
+{
+	struct bss_store_entry e;
+	struct bss_store_seen *s;
+	struct bss_store_bss *b;
+	__u32 idx, *chain = NULL, *tmp;
+	int n = 0, size = 0;
+
+	if (!bssid) {
+		for (idx = HDR_SLOTS; idx < hdr(st)->n_slots; ) {
+			s = slot(st, idx);
+			if (s->kind == BSS_STORE_BSS) {
+				idx += BSS_SLOTS;
+				continue;
+			}
+			idx++;
+			if (s->time < from || s->time > to)
+				continue;
+			store_entry(st, idx - 1, &e);
+			cb(&e, priv);
+		}
+		return 0;
+	}
+
+	if (!st->index_size || !*index_find(st, bssid))
+		return 0;
+
+	/* the chain goes back in time, report in the order of the file */
+	b = slot(st, *index_find(st, bssid));
+	for (idx = b->last; idx; idx = s->prev) {
+		s = slot(st, idx);
+		if (s->time < from)
+			break;
+		if (s->time > to)
+			continue;
+		if (n == size) {
+			size = size ? 2 * size : 64;
+			tmp = realloc(chain, size * sizeof(*chain));
+			if (!tmp) {
+				free(chain);
+				return -ENOMEM;
+			}
+			chain = tmp;
+		}
+		chain[n++] = idx;
+	}
+
+	while (n--) {
+		store_entry(st, chain[n], &e);
+		cb(&e, priv);
+	}
+	free(chain);
+	return 0;
+}
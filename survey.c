@@ -13,12 +13,43 @@
 
 SECTION(survey);
 
+static void print_survey_fmt(struct nlattr **tb, struct nlattr **sinfo)
+{
+	fmt_obj_begin(NULL);
+	if (tb[NL80211_ATTR_IFINDEX])
+		fmt_str("ifname",
+			iw_ifname(nla_get_u32(tb[NL80211_ATTR_IFINDEX])));
+	if (sinfo[NL80211_SURVEY_INFO_FREQUENCY])
+		fmt_uint("frequency",
+			 nla_get_u32(sinfo[NL80211_SURVEY_INFO_FREQUENCY]));
+	fmt_bool("in_use", !!sinfo[NL80211_SURVEY_INFO_IN_USE]);
+	if (sinfo[NL80211_SURVEY_INFO_NOISE])
+		fmt_int("noise",
+			(int8_t)nla_get_u8(sinfo[NL80211_SURVEY_INFO_NOISE]));
+	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME])
+		fmt_uint("active_ms",
+			 nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME]));
+	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_BUSY])
+		fmt_uint("busy_ms",
+			 nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_BUSY]));
+	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_EXT_BUSY])
+		fmt_uint("ext_busy_ms",
+			 nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_EXT_BUSY]));
+	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_RX])
+		fmt_uint("rx_ms",
+			 nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_RX]));
+	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_TX])
+		fmt_uint("tx_ms",
+			 nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_TX]));
+	fmt_obj_end();
+}
+
 static int print_survey_handler(struct nl_msg *msg, void *arg)
 {
 	struct nlattr *tb[NL80211_ATTR_MAX + 1];
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct nlattr *sinfo[NL80211_SURVEY_INFO_MAX + 1];
-	char dev[20];
+	const char *dev;
 
 	static struct nla_policy survey_policy[NL80211_SURVEY_INFO_MAX + 1] = {
 		[NL80211_SURVEY_INFO_FREQUENCY] = { .type = NLA_U32 },
@@ -28,8 +59,10 @@ static int print_survey_handler(struct nl_msg *msg, void *arg)
 	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
 		  genlmsg_attrlen(gnlh, 0), NULL);
 
-	if_indextoname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]), dev);
-	printf("Survey data from %s\n", dev);
+	if (iw_format == IW_FORMAT_TEXT) {
+		dev = iw_ifname(nla_get_u32(tb[NL80211_ATTR_IFINDEX]));
+		printf("Survey data from %s\n", dev);
+	}
 
 	if (!tb[NL80211_ATTR_SURVEY_INFO]) {
 		fprintf(stderr, "survey data missing!\n");
@@ -43,6 +76,11 @@ static int print_survey_handler(struct nl_msg *msg, void *arg)
 		return NL_SKIP;
 	}
 
+	if (iw_format != IW_FORMAT_TEXT) {
+		print_survey_fmt(tb, sinfo);
+		return NL_SKIP;
+	}
+
 	if (sinfo[NL80211_SURVEY_INFO_FREQUENCY])
 		printf("\tfrequency:\t\t\t%u MHz%s\n",
 			nla_get_u32(sinfo[NL80211_SURVEY_INFO_FREQUENCY]),
@@ -79,5 +117,6 @@ static int handle_survey_dump(struct nl80211_state *state,
 }
 COMMAND(survey, dump, NULL,
 	NL80211_CMD_GET_SURVEY, NLM_F_DUMP, CIB_NETDEV, handle_survey_dump,
-	"List all gathered channel survey data");
+	"List all gathered channel survey data",
+	.formats = true);
 
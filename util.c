@@ -121,6 +121,22 @@ unsigned char *parse_hex(char *hex, size_t *outlen)
 	return result;
 }
 
+/* parse a timeout in (possibly fractional) seconds into milliseconds */
+int parse_timeout(const char *arg, unsigned int *timeout)
+{
+	char *end;
+	double secs;
+
+	secs = strtod(arg, &end);
+	if (*end || end == arg || secs <= 0 || secs > 86400)
+		return -EINVAL;
+
+	*timeout = secs * 1000;
+	if (!*timeout)
+		*timeout = 1;
+	return 0;
+}
+
 static const char *ifmodes[NL80211_IFTYPE_MAX + 1] = {
 	"unspecified",
 	"IBSS",